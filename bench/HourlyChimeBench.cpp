@@ -0,0 +1,169 @@
+// HourlyChimeBench: times the note parser, synth, sample conversion and
+// analysis hot paths with Google Benchmark. Pass
+// --benchmark_format=json (or --benchmark_out=<file> --benchmark_out_format=json)
+// for results that can be compared across commits.
+#include "SynthGenerator.h"
+#include "Oscillator.h"
+#include "SampleAnalyzer.h"
+#include <QCoreApplication>
+#include <QStringList>
+#include <QtMath>
+#include <QVector>
+#include <benchmark/benchmark.h>
+
+namespace {
+
+QAudioFormat stereoFormat()
+{
+    QAudioFormat format;
+    format.setSampleRate(44100);
+    format.setChannelCount(2);
+    format.setSampleFormat(QAudioFormat::Int16);
+    return format;
+}
+
+QString longSequence(int tokens)
+{
+    static const char *pattern[] = {"C", "E", "G#", "Bb3", "-", "X", "C5", "F#4", "-", "A"};
+    QStringList list;
+    list.reserve(tokens);
+    for (int i = 0; i < tokens; ++i) {
+        list << QString::fromLatin1(pattern[i % 10]);
+    }
+    return list.join(' ');
+}
+
+void parseNotes(benchmark::State &state)
+{
+    const int tokens = static_cast<int>(state.range(0));
+    const QString notes = longSequence(tokens);
+    SynthGenerator generator(stereoFormat());
+    for (auto _ : state) {
+        generator.setSequence(notes, 1.0f, 1.0f);
+        benchmark::DoNotOptimize(generator.totalBytes());
+    }
+    state.SetItemsProcessed(state.iterations() * tokens);
+}
+BENCHMARK(parseNotes)->Arg(4)->Arg(10000)->Arg(100000);
+
+void parseNoteFreq(benchmark::State &state)
+{
+    const QStringList tokens = {"C", "C#", "Db", "D", "E", "F#3", "G", "Ab", "A", "Bb5", "B", "c2"};
+    for (auto _ : state) {
+        float sum = 0.0f;
+        for (const QString &token : tokens) {
+            sum += SynthGenerator::parseNoteFreq(token);
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * tokens.size());
+}
+BENCHMARK(parseNoteFreq);
+
+// Renders a long sequence in chunks of range(0) bytes, as a sink would pull it.
+void readData(benchmark::State &state)
+{
+    const QAudioFormat format = stereoFormat();
+    const qint64 chunk = state.range(0);
+    SynthGenerator generator(format);
+    generator.setSequence(longSequence(10000), 1.0f, 1.0f);
+    generator.start();
+
+    QByteArray buffer(chunk, Qt::Uninitialized);
+    for (auto _ : state) {
+        if (generator.readData(buffer.data(), chunk) < chunk) {
+            generator.start();
+        }
+        benchmark::DoNotOptimize(buffer.data());
+    }
+    state.SetItemsProcessed(state.iterations() * (chunk / format.bytesPerFrame()));
+}
+BENCHMARK(readData)->Arg(256)->Arg(4096)->Arg(65536);
+
+// Polyphony stress: one long chord of range(0) voices. The
+// realtime_voices_per_core counter is how many voices one core could keep
+// up with in real time; scale it by the CPU budget, e.g. a tenth of it fits
+// in 10% of a core.
+void voices(benchmark::State &state)
+{
+    const QAudioFormat format = stereoFormat();
+    const int voiceCount = static_cast<int>(state.range(0));
+    QStringList chord;
+    for (int v = 0; v < voiceCount; ++v) {
+        chord << QString("C%1").arg(2 + v % 6);
+    }
+    SynthGenerator generator(format);
+    generator.setSequence(chord.join('+') + QString(" -").repeated(1000), 1.0f, 1.0f);
+    generator.start();
+
+    constexpr int kChunk = 4096;
+    const int frames = kChunk / format.bytesPerFrame();
+    QByteArray buffer(kChunk, Qt::Uninitialized);
+    for (auto _ : state) {
+        if (generator.readData(buffer.data(), kChunk) < kChunk) {
+            generator.start();
+        }
+        benchmark::DoNotOptimize(buffer.data());
+    }
+    state.SetItemsProcessed(state.iterations() * frames);
+    state.counters["realtime_voices_per_core"] = benchmark::Counter(
+        static_cast<double>(state.iterations()) * frames * voiceCount / format.sampleRate(),
+        benchmark::Counter::kIsRate);
+}
+BENCHMARK(voices)->Arg(1)->Arg(8)->Arg(SynthGenerator::kMaxVoices);
+
+// Mono float block to interleaved stereo in each supported sample format.
+template<QAudioFormat::SampleFormat Format>
+void writeMono(benchmark::State &state)
+{
+    using Sample = typename SampleWriter::Traits<Format>::Type;
+    constexpr int kBlock = 256;
+    QVector<float> floats(kBlock, 0.25f);
+    QVector<Sample> pcm(kBlock * 2);
+    for (auto _ : state) {
+        SampleWriter::writeMono<Format>(floats.constData(), pcm.data(), kBlock, 2);
+        benchmark::DoNotOptimize(pcm.data());
+    }
+    state.SetItemsProcessed(state.iterations() * kBlock);
+}
+BENCHMARK(writeMono<QAudioFormat::Int16>)->Name("writeMono/int16");
+BENCHMARK(writeMono<QAudioFormat::Int32>)->Name("writeMono/int32");
+BENCHMARK(writeMono<QAudioFormat::Float>)->Name("writeMono/float");
+
+// A 3 s bell-like strike: what the decoder thread spends analyzing a typical
+// strike file (loudness, silence and the onset detector).
+void analyzeSample(benchmark::State &state)
+{
+    const QAudioFormat format = stereoFormat();
+    const int frames = format.sampleRate() * 3;
+    QVector<float> strike(frames * 2);
+    for (int f = 0; f < frames; ++f) {
+        const double t = static_cast<double>(f) / format.sampleRate();
+        const float x = static_cast<float>(0.3 * qExp(-t / 0.6)
+                                           * (qSin(2.0 * M_PI * 440.0 * t) + 0.5 * qSin(2.0 * M_PI * 1093.0 * t)));
+        strike[2 * f] = x;
+        strike[2 * f + 1] = x;
+    }
+    for (auto _ : state) {
+        SampleAnalyzer analyzer(format.sampleRate(), 2);
+        analyzer.feed(strike.constData(), frames);
+        benchmark::DoNotOptimize(analyzer.result().strikeIntervalUs);
+    }
+    state.SetItemsProcessed(state.iterations() * frames);
+}
+BENCHMARK(analyzeSample);
+
+}
+
+int main(int argc, char *argv[])
+{
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    QCoreApplication app(argc, argv);
+
+    benchmark::AddCustomContext("version", HOURLY_CHIME_VERSION_STR);
+    benchmark::AddCustomContext("build_date", HOURLY_CHIME_DATE_STR);
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,410 @@
+#include "AudioRenderer.h"
+#include "CaptureSink.h"
+#include "Mixer.h"
+#include "Trace.h"
+#include <QAudioSink>
+#include <QDebug>
+#include <QIODevice>
+#include <QTimer>
+#include <QVector>
+#include <chrono>
+#include <cstring>
+
+// Sink-facing end of the ring, read by the sink on the render thread.
+class AudioRenderer::Output : public QIODevice
+{
+public:
+    Output(Shared &shared, Worker *worker, const QAudioFormat &format);
+
+    bool isSequential() const override { return true; }
+    qint64 readData(char *data, qint64 maxlen) override;
+    qint64 writeData(const char *data, qint64 len) override;
+    qint64 bytesAvailable() const override;
+
+private:
+    Shared &m_shared;
+    Worker *m_worker;
+    int m_bytesPerFrame;
+};
+
+// Owns the Mixer, the sink and its Output on the render thread, and tops the
+// ring up on a short timer while anything is playing. The ring's producer
+// and consumer both run here, so only this thread ever moves through it.
+class AudioRenderer::Worker : public QObject
+{
+public:
+    Worker(AudioRenderer *owner, Shared &shared, const QAudioFormat &format)
+        : m_owner(owner)
+        , m_shared(shared)
+        , m_format(format)
+        , m_mixer(new Mixer(format, this))
+        , m_output(new Output(shared, this, format))
+        , m_sink(nullptr)
+        , m_capture(nullptr)
+        , m_timer(new QTimer(this))
+        , m_bytesPerFrame(format.bytesPerFrame())
+        , m_generation(0)
+        , m_sequenceStart(0)
+        , m_flushedTo(0)
+    {
+        m_mixer->open(QIODevice::ReadOnly);
+        // Unbuffered, so every read reaches the ring and voices are reported
+        // started when the sink itself gets their first frame.
+        m_output->open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+        m_unheard.reserve(Mixer::kMaxVoices * 2);
+        m_timer->setTimerType(Qt::PreciseTimer);
+        m_timer->setInterval(kRenderIntervalMs);
+        connect(m_timer, &QTimer::timeout, this, &Worker::render);
+        connect(m_mixer, &Mixer::voiceStarted, this, &Worker::onVoiceStarted);
+    }
+
+    Mixer *mixer() const { return m_mixer; }
+
+    template<typename Source>
+    void start(quint32 generation, int id, const Source &source, float gain, qint64 delayFrames)
+    {
+        applyStop();
+        // A play() issued before the latest stopAll() is dropped.
+        if (generation == m_generation) {
+            // The mixer counts a delay from what it has already mixed, which
+            // each start() moves on by a ring's worth; the caller counts from
+            // the voice that opened the sequence.
+            const qint64 mixed = m_shared.ring.writePosition() / m_bytesPerFrame;
+            if (delayFrames == 0) m_sequenceStart = mixed;
+            m_mixer->play(id, source, gain, qMax<qint64>(0, m_sequenceStart + delayFrames - mixed));
+        } else {
+            discard(source);
+        }
+        render();
+        m_shared.pendingVoices.fetch_sub(1, std::memory_order_release);
+        if (!m_timer->isActive()) m_timer->start();
+    }
+
+    void render()
+    {
+        TRACE_SCOPE("AudioRenderer::render");
+        applyStop();
+        for (;;) {
+            qint64 length = 0;
+            char *span = m_shared.ring.writeSpan(&length);
+            length -= length % m_bytesPerFrame;
+            if (length <= 0) break;
+            qint64 n = m_mixer->readData(span, length);
+            if (n <= 0) break;
+            m_shared.ring.commit(n);
+        }
+
+        const bool active = m_mixer->isActive();
+        m_shared.mixerActive.store(active, std::memory_order_release);
+        if (!active) m_timer->stop();
+    }
+
+    // Acts on a stopAll() from the GUI thread: silences the mixer and drops
+    // whatever the stopped chime left in the ring.
+    void applyStop()
+    {
+        const quint32 generation = m_shared.stopGeneration.load(std::memory_order_acquire);
+        if (generation == m_generation) return;
+
+        m_generation = generation;
+        m_mixer->stopAll();
+        m_shared.mixerActive.store(false, std::memory_order_release);
+        m_flushedTo = m_shared.ring.writePosition();
+        m_shared.ring.skipTo(m_flushedTo);
+        m_unheard.clear();
+    }
+
+    // Called by the Output after each read: voices whose first frame has now
+    // been read are reported as started.
+    void noteRead(qint64 readPosition)
+    {
+        if (m_unheard.isEmpty()) return;
+        const qint64 now = steadyNowNs();
+        for (int i = 0; i < m_unheard.size(); ) {
+            if (m_unheard[i].position < readPosition) {
+                emit m_owner->voiceStarted(m_unheard[i].id, now);
+                m_unheard.remove(i);
+            } else {
+                ++i;
+            }
+        }
+    }
+
+    void openSink(const QAudioDevice &device, qint64 bufferBytes)
+    {
+        TRACE_SCOPE("AudioRenderer::openSink");
+        closeSink();
+        m_sink = new QAudioSink(device, m_format, this);
+        m_sink->setVolume(1.0f);
+        m_sink->setBufferSize(bufferBytes);
+        connect(m_sink, &QAudioSink::stateChanged, this, &Worker::onSinkStateChanged);
+
+        // With nothing to mix it goes idle and the GUI thread suspends it.
+        m_sink->start(m_output);
+    }
+
+    void openCapture(CaptureSink *capture)
+    {
+        closeSink();
+        m_capture = capture;
+        m_capture->start(m_output);
+    }
+
+    void resumeSink()
+    {
+        if (m_capture) {
+            drainCapture();
+            return;
+        }
+        if (!m_sink) return;
+        switch (m_sink->state()) {
+        case QAudio::SuspendedState:
+            m_sink->resume();
+            break;
+        case QAudio::StoppedState:
+            m_sink->start(m_output);
+            break;
+        default:
+            break;
+        }
+    }
+
+    void suspendSink()
+    {
+        if (m_sink && m_sink->state() != QAudio::StoppedState) m_sink->suspend();
+    }
+
+    void flushSink()
+    {
+        applyStop();
+        if (!m_sink) return;
+        m_sink->stop();
+        m_sink->start(m_output);
+    }
+
+private:
+    struct Start {
+        int id;
+        qint64 position; // ring position of the voice's first frame
+    };
+
+    static void discard(const QByteArray &) {}
+    static void discard(const SampleStreamPtr &stream) { stream->cancel(); }
+
+    static qint64 steadyNowNs()
+    {
+        using namespace std::chrono;
+        return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    void onVoiceStarted(int id, qint64 frame)
+    {
+        // Every frame the mixer produces goes into the ring, in order.
+        const qint64 position = frame * m_bytesPerFrame;
+        if (position < m_flushedTo) return; // stopped before it was heard
+        m_unheard.append(Start{id, position});
+        noteRead(m_shared.ring.readPosition());
+    }
+
+    // Pulls the ring dry, topping it up before every pull so the capture
+    // never sees padding, then goes idle as a sink would.
+    void drainCapture()
+    {
+        TRACE_SCOPE("AudioRenderer::drainCapture");
+        for (;;) {
+            render();
+            if (m_capture->pull(kRingFrames) < kRingFrames) break;
+        }
+        emit m_owner->sinkStateChanged(QAudio::IdleState, QAudio::NoError);
+    }
+
+    void onSinkStateChanged(QAudio::State state)
+    {
+        const QAudio::Error error = m_sink->error();
+        emit m_owner->sinkStateChanged(state, error);
+        if (state == QAudio::StoppedState && error != QAudio::NoError) {
+            qWarning() << "AudioSink error:" << error;
+            closeSink();
+        }
+    }
+
+    void closeSink()
+    {
+        m_capture = nullptr;
+        if (!m_sink) return;
+        m_sink->disconnect(this);
+        m_sink->stop();
+        m_sink->deleteLater();
+        m_sink = nullptr;
+    }
+
+    AudioRenderer *m_owner;
+    Shared &m_shared;
+    QAudioFormat m_format;
+    Mixer *m_mixer;
+    Output *m_output;
+    QAudioSink *m_sink;
+    CaptureSink *m_capture; // instead of m_sink
+    QTimer *m_timer;
+    int m_bytesPerFrame;
+    quint32 m_generation;
+    qint64 m_sequenceStart; // mixer frame of the last voice started without a delay
+    qint64 m_flushedTo; // ring position the last stop dropped everything before
+    QVector<Start> m_unheard; // mixed into the ring, not yet read by the sink
+};
+
+AudioRenderer::Output::Output(Shared &shared, Worker *worker, const QAudioFormat &format)
+    : QIODevice(worker)
+    , m_shared(shared)
+    , m_worker(worker)
+    , m_bytesPerFrame(format.bytesPerFrame())
+{
+}
+
+qint64 AudioRenderer::Output::readData(char *data, qint64 maxlen)
+{
+    TRACE_SCOPE("AudioRenderer::Output::readData", maxlen);
+    // A stopAll() the timer hasn't picked up yet still silences this read.
+    m_worker->applyStop();
+
+    const qint64 wanted = maxlen - maxlen % m_bytesPerFrame;
+    const qint64 n = m_shared.ring.read(data, wanted);
+    m_worker->noteRead(m_shared.ring.readPosition());
+    if (n == wanted) return n;
+
+    // Short with voices still queued or mixing: pad with silence rather than
+    // returning less, which the sink would take as the end of the chime.
+    const bool mixing = m_shared.mixerActive.load(std::memory_order_acquire);
+    if (!mixing && m_shared.pendingVoices.load(std::memory_order_acquire) == 0) {
+        return n;
+    }
+    std::memset(data + n, 0, wanted - n);
+    if (mixing) {
+        Trace::instant("underrun", (wanted - n) / m_bytesPerFrame);
+        m_shared.underruns.fetch_add(1, std::memory_order_relaxed);
+        m_shared.underrunFrames.fetch_add((wanted - n) / m_bytesPerFrame, std::memory_order_relaxed);
+    }
+    return wanted;
+}
+
+qint64 AudioRenderer::Output::writeData(const char *data, qint64 len)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(len);
+    return 0;
+}
+
+qint64 AudioRenderer::Output::bytesAvailable() const
+{
+    return m_shared.ring.readAvailable() + QIODevice::bytesAvailable();
+}
+
+AudioRenderer::AudioRenderer(const QAudioFormat &format, QObject *parent)
+    : QObject(parent)
+    , m_format(format)
+    , m_shared(static_cast<qint64>(kRingFrames) * format.bytesPerFrame())
+    , m_worker(new Worker(this, m_shared, format))
+    , m_nextId(1)
+    , m_capturing(false)
+    , m_drainQueued(false)
+{
+    m_worker->moveToThread(&m_thread);
+    connect(&m_thread, &QThread::finished, m_worker, &QObject::deleteLater);
+    connect(m_worker->mixer(), &Mixer::voiceFinished, this, &AudioRenderer::voiceFinished);
+    // Runs on the new thread, before anything it mixes is traced.
+    connect(&m_thread, &QThread::started, []() { Trace::registerThread(); });
+    m_thread.setObjectName("AudioRenderer");
+    m_thread.start(QThread::TimeCriticalPriority);
+}
+
+AudioRenderer::~AudioRenderer()
+{
+    m_thread.quit();
+    m_thread.wait();
+}
+
+int AudioRenderer::play(const QByteArray &pcm, float gain, qint64 delayFrames)
+{
+    if (pcm.isEmpty()) return -1;
+    return enqueue(pcm, gain, delayFrames);
+}
+
+int AudioRenderer::play(const SampleStreamPtr &stream, float gain, qint64 delayFrames)
+{
+    if (!stream) return -1;
+    return enqueue(stream, gain, delayFrames);
+}
+
+template<typename Source>
+int AudioRenderer::enqueue(const Source &source, float gain, qint64 delayFrames)
+{
+    const int id = m_nextId.fetch_add(1, std::memory_order_relaxed);
+    const quint32 generation = m_shared.stopGeneration.load(std::memory_order_relaxed);
+    m_shared.pendingVoices.fetch_add(1, std::memory_order_release);
+
+    Worker *worker = m_worker;
+    QMetaObject::invokeMethod(worker, [worker, generation, id, source, gain, delayFrames]() {
+        worker->start(generation, id, source, gain, delayFrames);
+    }, Qt::QueuedConnection);
+    return id;
+}
+
+void AudioRenderer::stopAll()
+{
+    // The render thread drops what is already mixed as soon as it sees the
+    // new generation, at the latest on the sink's next pull.
+    m_shared.stopGeneration.fetch_add(1, std::memory_order_acq_rel);
+
+    Worker *worker = m_worker;
+    QMetaObject::invokeMethod(worker, [worker]() { worker->render(); }, Qt::QueuedConnection);
+}
+
+bool AudioRenderer::isActive() const
+{
+    return m_shared.pendingVoices.load(std::memory_order_acquire) > 0
+        || m_shared.mixerActive.load(std::memory_order_acquire);
+}
+
+void AudioRenderer::openSink(const QAudioDevice &device, qint64 bufferBytes)
+{
+    m_capturing = false;
+    Worker *worker = m_worker;
+    QMetaObject::invokeMethod(worker, [worker, device, bufferBytes]() { worker->openSink(device, bufferBytes); },
+                              Qt::QueuedConnection);
+}
+
+void AudioRenderer::resumeSink()
+{
+    Worker *worker = m_worker;
+    if (m_capturing) {
+        // A sequence is queued one play() and resumeSink() at a time; drain
+        // once it is all in, as a real sink would only get to it by then.
+        if (m_drainQueued) return;
+        m_drainQueued = true;
+        QMetaObject::invokeMethod(this, [this, worker]() {
+            m_drainQueued = false;
+            QMetaObject::invokeMethod(worker, [worker]() { worker->resumeSink(); }, Qt::QueuedConnection);
+        }, Qt::QueuedConnection);
+        return;
+    }
+    QMetaObject::invokeMethod(worker, [worker]() { worker->resumeSink(); }, Qt::QueuedConnection);
+}
+
+void AudioRenderer::suspendSink()
+{
+    Worker *worker = m_worker;
+    QMetaObject::invokeMethod(worker, [worker]() { worker->suspendSink(); }, Qt::QueuedConnection);
+}
+
+void AudioRenderer::flushSink()
+{
+    Worker *worker = m_worker;
+    QMetaObject::invokeMethod(worker, [worker]() { worker->flushSink(); }, Qt::QueuedConnection);
+}
+
+void AudioRenderer::openCapture(CaptureSink *capture)
+{
+    m_capturing = true;
+    Worker *worker = m_worker;
+    QMetaObject::invokeMethod(worker, [worker, capture]() { worker->openCapture(capture); }, Qt::QueuedConnection);
+}
@@ -0,0 +1,101 @@
+#ifndef AUDIORENDERER_H
+#define AUDIORENDERER_H
+
+#include <QObject>
+#include <QAudio>
+#include <QAudioDevice>
+#include <QAudioFormat>
+#include <QThread>
+#include <atomic>
+#include "RingBuffer.h"
+#include "SampleStream.h"
+
+class CaptureSink;
+class Mixer;
+class QTimer;
+
+// Runs the Mixer and the QAudioSink on a thread of their own, so neither
+// mixing nor the backend's pulls ever wait on the GUI thread: a stalled UI
+// cannot starve a chime. The mixer keeps a ring topped up on a short timer and
+// the sink's pulls drain it; both happen on the render thread, so the ring
+// only decouples mix size from pull size. Every public function is called
+// from the GUI thread and talks to the render thread through the atomics in
+// Shared; sink control is carried out on the render thread and reported back
+// through sinkStateChanged().
+class AudioRenderer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit AudioRenderer(const QAudioFormat &format, QObject *parent = nullptr);
+    ~AudioRenderer();
+
+    // Same contract as Mixer::play(), except that `delayFrames` counts from
+    // the start of the last voice played without a delay: the render thread
+    // mixes ahead, so "the last frame already read" would move while a
+    // sequence is still being queued. The voice starts on the render thread.
+    int play(const QByteArray &pcm, float gain, qint64 delayFrames = 0);
+    int play(const SampleStreamPtr &stream, float gain, qint64 delayFrames = 0);
+    void stopAll();
+    bool isActive() const;
+
+    // Opens a sink on `device` with a `bufferBytes` buffer, replacing any
+    // open one, and starts it right away: opening the backend stream is the
+    // slow part, so a chime then only has to resume it.
+    void openSink(const QAudioDevice &device, qint64 bufferBytes);
+    // Has the sink pull the mix again, restarting it if it was stopped.
+    void resumeSink();
+    // Stops the sink pulling, keeping the backend stream open.
+    void suspendSink();
+    // Drops whatever the backend already has queued, then re-warms it.
+    void flushSink();
+    // Replaces the sink with `capture`, for tests. Once the caller returns to
+    // the event loop, resumeSink() then pulls everything queued as fast as it
+    // mixes and reports IdleState when the mix runs out. `capture` must
+    // outlive the renderer.
+    void openCapture(CaptureSink *capture);
+
+    // Pulls that found the ring short while voices were playing, and the
+    // silence padded in for them.
+    quint64 underruns() const { return m_shared.underruns.load(std::memory_order_relaxed); }
+    quint64 underrunFrames() const { return m_shared.underrunFrames.load(std::memory_order_relaxed); }
+
+signals:
+    // Carries the steady_clock time at which the sink read the voice's first
+    // frame out of the ring.
+    void voiceStarted(int id, qint64 steadyNs);
+    void voiceFinished(int id);
+    // A sink that fails is closed; the next openSink() replaces it.
+    void sinkStateChanged(QAudio::State state, QAudio::Error error);
+
+private:
+    static constexpr int kRingFrames = 4096;
+    static constexpr int kRenderIntervalMs = 5;
+
+    struct Shared {
+        explicit Shared(qint64 ringBytes) : ring(ringBytes) {}
+
+        RingBuffer ring; // render thread only
+        std::atomic<int> pendingVoices{0};    // play() calls the render thread hasn't taken yet
+        std::atomic<bool> mixerActive{false};
+        std::atomic<quint32> stopGeneration{0};
+        std::atomic<quint64> underruns{0};
+        std::atomic<quint64> underrunFrames{0};
+    };
+
+    class Worker;
+    class Output;
+
+    template<typename Source>
+    int enqueue(const Source &source, float gain, qint64 delayFrames);
+
+    QAudioFormat m_format;
+    Shared m_shared;
+    QThread m_thread;
+    Worker *m_worker;
+    std::atomic<int> m_nextId;
+    bool m_capturing;
+    bool m_drainQueued; // a capture drain is waiting for the event loop
+};
+
+#endif // AUDIORENDERER_H
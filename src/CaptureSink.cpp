@@ -0,0 +1,44 @@
+#include "CaptureSink.h"
+#include "Oscillator.h"
+#include <cmath>
+
+CaptureSink::CaptureSink(const QAudioFormat &format)
+    : m_format(format)
+    , m_source(nullptr)
+{
+}
+
+qint64 CaptureSink::pull(qint64 frames)
+{
+    if (!m_source) return 0;
+    const int bytesPerFrame = m_format.bytesPerFrame();
+    const qint64 offset = m_captured.size();
+    m_captured.resize(offset + frames * bytesPerFrame);
+    const qint64 n = qMax<qint64>(0, m_source->read(m_captured.data() + offset, frames * bytesPerFrame));
+    m_captured.resize(offset + n - n % bytesPerFrame);
+    return n / bytesPerFrame;
+}
+
+QVector<qint64> CaptureSink::onsets(float threshold, int gapFrames) const
+{
+    const int channels = m_format.channelCount();
+    const qint64 frames = capturedFrames();
+    QVector<float> samples(frames * channels, 0.0f);
+    SampleWriter::accumulator(m_format.sampleFormat())(m_captured.constData(), samples.data(), static_cast<int>(samples.size()), 1.0f);
+
+    QVector<qint64> result;
+    qint64 quietRun = gapFrames;
+    for (qint64 f = 0; f < frames; ++f) {
+        bool loud = false;
+        for (int c = 0; c < channels; ++c) {
+            if (std::fabs(samples[f * channels + c]) > threshold) loud = true;
+        }
+        if (!loud) {
+            ++quietRun;
+            continue;
+        }
+        if (quietRun >= gapFrames) result.append(f);
+        quietRun = 0;
+    }
+    return result;
+}
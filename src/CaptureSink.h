@@ -0,0 +1,38 @@
+#ifndef CAPTURESINK_H
+#define CAPTURESINK_H
+
+#include <QAudioFormat>
+#include <QByteArray>
+#include <QIODevice>
+#include <QVector>
+
+// Null audio backend: pulls a source the way QAudioSink would, but only when
+// asked and as fast as the CPU allows, and keeps what it read instead of
+// playing it. Lets the tests run AudioRenderer without an audio device and
+// check the output sample by sample.
+class CaptureSink
+{
+public:
+    explicit CaptureSink(const QAudioFormat &format);
+
+    QAudioFormat format() const { return m_format; }
+    void start(QIODevice *source) { m_source = source; }
+    // Reads up to `frames` frames; returns how many the source had.
+    qint64 pull(qint64 frames);
+
+    const QByteArray &captured() const { return m_captured; }
+    qint64 capturedFrames() const { return m_captured.size() / m_format.bytesPerFrame(); }
+    void clear() { m_captured.clear(); }
+
+    // Frames at which a sound begins: the first frame louder than
+    // `threshold` (of full scale, any channel) after at least `gapFrames`
+    // frames that were not. The very first frame counts as preceded by a gap.
+    QVector<qint64> onsets(float threshold, int gapFrames) const;
+
+private:
+    QAudioFormat m_format;
+    QIODevice *m_source;
+    QByteArray m_captured;
+};
+
+#endif // CAPTURESINK_H
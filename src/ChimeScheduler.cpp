@@ -0,0 +1,150 @@
+#include "ChimeScheduler.h"
+#include "Clock.h"
+#include <QTimer>
+#include <QSocketNotifier>
+#include <QDebug>
+
+#ifdef Q_OS_LINUX
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <cerrno>
+#ifndef TFD_TIMER_CANCEL_ON_SET
+#define TFD_TIMER_CANCEL_ON_SET (1 << 1)
+#endif
+#endif
+
+ChimeScheduler::ChimeScheduler(QObject *parent)
+    : ChimeScheduler(Clock::system(), parent)
+{
+}
+
+ChimeScheduler::ChimeScheduler(Clock *clock, QObject *parent)
+    : QObject(parent)
+    , m_clock(clock)
+    , m_wakeMs(0)
+    , m_timer(new QTimer(this))
+    , m_timerFd(-1)
+    , m_notifier(nullptr)
+{
+    m_timer->setSingleShot(true);
+    m_timer->setTimerType(Qt::PreciseTimer);
+    connect(m_timer, &QTimer::timeout, this, &ChimeScheduler::onWake);
+
+#ifdef Q_OS_LINUX
+    if (m_clock->isVirtual()) return;
+    m_timerFd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (m_timerFd >= 0) {
+        m_notifier = new QSocketNotifier(m_timerFd, QSocketNotifier::Read, this);
+        m_notifier->setEnabled(false);
+        connect(m_notifier, &QSocketNotifier::activated, this, &ChimeScheduler::onWake);
+    } else {
+        qWarning() << "timerfd_create failed, falling back to QTimer:" << errno;
+    }
+#endif
+}
+
+ChimeScheduler::~ChimeScheduler()
+{
+#ifdef Q_OS_LINUX
+    if (m_timerFd >= 0) {
+        delete m_notifier;
+        ::close(m_timerFd);
+    }
+#endif
+}
+
+void ChimeScheduler::start()
+{
+    arm(m_clock->now());
+}
+
+void ChimeScheduler::stop()
+{
+    m_timer->stop();
+#ifdef Q_OS_LINUX
+    if (m_timerFd >= 0) {
+        itimerspec spec{};
+        timerfd_settime(m_timerFd, 0, &spec, nullptr);
+        m_notifier->setEnabled(false);
+    }
+#endif
+    m_target = QDateTime();
+    m_wakeMs = 0;
+}
+
+QDateTime ChimeScheduler::boundaryAfter(const QDateTime &time)
+{
+    // Steps forward from `time` itself rather than rebuilding the hour from
+    // its date and hour: addMSecs works on the underlying UTC instant, so
+    // across a DST change this still lands on the first instant of the next
+    // local hour, a repeated hour is reached twice instead of resolving to
+    // the same instant again, and `time`'s zone is kept.
+    auto toNextHour = [](const QDateTime &from) {
+        const QTime t = from.time();
+        return from.addMSecs(3600 * 1000 - ((t.minute() * 60 + t.second()) * 1000 + t.msec()));
+    };
+    QDateTime next = toNextHour(time);
+    // Only lands off the hour where the offset changes by part of an hour
+    // (Lord Howe Island); the hour then starts at the next :00.
+    if (next.time().minute() != 0) next = toNextHour(next);
+    return next;
+}
+
+void ChimeScheduler::arm(const QDateTime &now)
+{
+    m_target = boundaryAfter(now);
+    armAt(qMin(m_target.toMSecsSinceEpoch(), now.toMSecsSinceEpoch() + kResyncMs));
+}
+
+void ChimeScheduler::armAt(qint64 wakeMs)
+{
+    m_wakeMs = wakeMs;
+    if (m_clock->isVirtual()) return;
+
+#ifdef Q_OS_LINUX
+    if (m_timerFd >= 0) {
+        itimerspec spec{};
+        spec.it_value.tv_sec = wakeMs / 1000;
+        spec.it_value.tv_nsec = (wakeMs % 1000) * 1000000;
+        if (timerfd_settime(m_timerFd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &spec, nullptr) == 0) {
+            m_notifier->setEnabled(true);
+            return;
+        }
+        qWarning() << "timerfd_settime failed, falling back to QTimer:" << errno;
+    }
+#endif
+    qint64 delay = wakeMs - m_clock->nowMs();
+    m_timer->start(static_cast<int>(qBound<qint64>(1, delay, kResyncMs)));
+}
+
+void ChimeScheduler::onWake()
+{
+#ifdef Q_OS_LINUX
+    if (m_timerFd >= 0) {
+        // A read failing with ECANCELED means the wall clock was set; in that
+        // case the target is simply re-derived below like any early wakeup.
+        quint64 expirations = 0;
+        if (::read(m_timerFd, &expirations, sizeof(expirations)) < 0 && errno == ECANCELED) {
+            qDebug() << "Wall clock changed, re-arming chime scheduler";
+        }
+    }
+#endif
+
+    QDateTime now = m_clock->now();
+    if (m_target.isValid()) {
+        qint64 lateMs = m_target.msecsTo(now);
+        if (lateMs >= 0) {
+            QDateTime reached = m_target;
+            arm(now);
+            if (lateMs <= kLateGraceMs) {
+                emit hourReached(reached);
+            } else {
+                qDebug() << "Skipping chime missed by" << lateMs << "ms";
+            }
+            return;
+        }
+    }
+
+    // Early, resync or clock-change wakeup: the local hour may have moved.
+    arm(now);
+}
@@ -0,0 +1,64 @@
+#ifndef CHIMESCHEDULER_H
+#define CHIMESCHEDULER_H
+
+#include <QObject>
+#include <QDateTime>
+
+class Clock;
+class QTimer;
+class QSocketNotifier;
+
+// Sleeps until the next local hour boundary instead of polling the clock.
+// On Linux the wakeup is a timerfd armed against CLOCK_REALTIME, so it fires
+// on time after suspend/resume and is cancelled when the wall clock is set.
+// Elsewhere a precise single-shot QTimer is used. Either way the target is
+// re-derived from local time at least every kResyncMs so timezone and DST
+// changes are picked up without needing a dedicated notification.
+// With a virtual Clock no timer is armed at all: whoever advances the clock
+// calls wake() once it reaches wakeTimeMs().
+class ChimeScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    // A boundary missed by more than this (suspend, clock jump) is skipped
+    // rather than chimed late.
+    static constexpr qint64 kLateGraceMs = 5000;
+
+    explicit ChimeScheduler(QObject *parent = nullptr);
+    ChimeScheduler(Clock *clock, QObject *parent = nullptr);
+    ~ChimeScheduler();
+
+    void start();
+    void stop();
+
+    QDateTime nextBoundary() const { return m_target; }
+    // When the scheduler next wants to run, as ms since the epoch.
+    qint64 wakeTimeMs() const { return m_wakeMs; }
+    // What the timer does when it fires; only for virtual clocks.
+    void wake() { onWake(); }
+
+    static QDateTime boundaryAfter(const QDateTime &time);
+
+signals:
+    void hourReached(const QDateTime &boundary);
+
+private slots:
+    void onWake();
+
+private:
+    void arm(const QDateTime &now);
+    void armAt(qint64 wakeMs);
+
+    // Maximum sleep before re-deriving the boundary from local time.
+    static constexpr qint64 kResyncMs = 15 * 60 * 1000;
+
+    Clock *m_clock;
+    QDateTime m_target;
+    qint64 m_wakeMs;
+    QTimer *m_timer;
+    int m_timerFd;
+    QSocketNotifier *m_notifier;
+};
+
+#endif // CHIMESCHEDULER_H
@@ -0,0 +1,23 @@
+#include "Clock.h"
+#include <chrono>
+
+namespace {
+
+class SystemClock : public Clock
+{
+public:
+    QDateTime now() const override { return QDateTime::currentDateTime(); }
+    qint64 nowUs() const override
+    {
+        using namespace std::chrono;
+        return duration_cast<microseconds>(system_clock::now().time_since_epoch()).count();
+    }
+};
+
+}
+
+Clock *Clock::system()
+{
+    static SystemClock clock;
+    return &clock;
+}
@@ -0,0 +1,49 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <QDateTime>
+#include <QTimeZone>
+
+// Where the chime logic gets the wall-clock time from. The app uses
+// Clock::system(); the simulation test drives a VirtualClock instead, so
+// weeks of hours (DST changes, suspends) can be played through in seconds.
+class Clock
+{
+public:
+    virtual ~Clock() = default;
+
+    virtual QDateTime now() const = 0;
+    qint64 nowMs() const { return now().toMSecsSinceEpoch(); }
+    // Microseconds since the epoch, for measuring lateness against a boundary.
+    virtual qint64 nowUs() const { return nowMs() * 1000; }
+    // True if time only moves when told to. Nothing may then wait on a real
+    // timer; the owner of the clock wakes things up itself.
+    virtual bool isVirtual() const { return false; }
+
+    // The process-wide local wall clock.
+    static Clock *system();
+};
+
+// Stands still until set, and reports local time in a fixed zone rather
+// than the system's, so a simulation gives the same answer anywhere.
+class VirtualClock : public Clock
+{
+public:
+    VirtualClock(qint64 msecsSinceEpoch, const QTimeZone &zone)
+        : m_ms(msecsSinceEpoch)
+        , m_zone(zone)
+    {
+    }
+
+    QDateTime now() const override { return QDateTime::fromMSecsSinceEpoch(m_ms, m_zone); }
+    bool isVirtual() const override { return true; }
+
+    void setMSecsSinceEpoch(qint64 ms) { m_ms = ms; }
+    QTimeZone zone() const { return m_zone; }
+
+private:
+    qint64 m_ms;
+    QTimeZone m_zone;
+};
+
+#endif // CLOCK_H
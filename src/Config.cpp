@@ -1,5 +1,8 @@
 #include "Config.h"
+#include "NoteTable.h"
+#include "Trace.h"
 #include <QFile>
+#include <QFileInfo>
 #include <QJsonDocument>
 #include <QStandardPaths>
 #include <QDir>
@@ -8,32 +11,36 @@ namespace Config {
 
 QString getConfigPath() {
     QString path = QStandardPaths::writableLocation(QStandardPaths::ConfigLocation);
-    QDir dir(path);
-    if (!dir.exists("hourlychime")) {
-        dir.mkdir("hourlychime");
-    }
-    return dir.filePath("hourlychime/config.json");
+    return QDir(path).filePath("hourlychime/config.json");
 }
 
-void ensureAssets() {
-    QString configPath = QStandardPaths::writableLocation(QStandardPaths::ConfigLocation);
-    QDir dir(configPath);
-    QString soundsDirPath = dir.filePath("hourlychime/sounds");
-    
-    if (!QDir(soundsDirPath).exists()) {
-        dir.mkpath("hourlychime/sounds");
-    }
-    
-    auto copyIfMissing = [&](const QString &resPath, const QString &fileName) {
-        QString destPath = QDir(soundsDirPath).filePath(fileName);
-        if (!QFile::exists(destPath)) {
-            QFile::copy(resPath, destPath);
-            QFile::setPermissions(destPath, QFile::ReadOwner | QFile::WriteOwner | QFile::ReadGroup | QFile::ReadOther);
-        }
-    };
-
-    copyIfMissing(":/sounds/gc-chime.mp3", "gc-chime.mp3");
-    copyIfMissing(":/sounds/gc-prelude.mp3", "gc-prelude.mp3");
+QString cachePath(const QString &name) {
+    return QFileInfo(getConfigPath()).absoluteDir().filePath(QStringLiteral("cache/") + name);
+}
+
+bool makeCacheDir() {
+    QDir configDir = QFileInfo(getConfigPath()).absoluteDir();
+    return configDir.exists() && configDir.mkpath("cache");
+}
+
+bool isBuiltinSound(const QString &path) {
+    return path.startsWith(QLatin1String("builtin:"));
+}
+
+QString builtinResourcePath(const QString &path) {
+    return QStringLiteral(":/sounds/") + path.mid(8);
+}
+
+// Older versions copied the bundled sounds into the config directory and
+// stored those paths; point untouched copies back at the built-in originals.
+static QString migrateLegacySound(const QString &path) {
+    QString legacyDir = QDir(QStandardPaths::writableLocation(QStandardPaths::ConfigLocation)).filePath("hourlychime/sounds");
+    QFileInfo info(path);
+    if (info.absolutePath() != legacyDir) return path;
+
+    QFileInfo resource(QStringLiteral(":/sounds/") + info.fileName());
+    if (!resource.exists() || (info.exists() && info.size() != resource.size())) return path;
+    return QStringLiteral("builtin:") + info.fileName();
 }
 
 AppConfig getDefaults() {
@@ -41,21 +48,25 @@ AppConfig getDefaults() {
     cfg.mode = "Notes";
     cfg.notes = "C E G C5";
     cfg.noteSpeed = 1.0f;
+    cfg.referencePitch = NoteTable::kDefaultReference;
     cfg.strikeIntervalMs = 2000;
     cfg.volume = 1.0f;
+    cfg.cacheRenderedNotes = false;
+    cfg.sinkBufferMs = 0;
+    cfg.updateCheckHours = 24;
+    cfg.streamThresholdKb = 2048;
+    cfg.streamBufferMs = 2000;
+    cfg.normalizeSamples = true;
 
-    QString configPath = QStandardPaths::writableLocation(QStandardPaths::ConfigLocation);
-    QString soundsDir = QDir(configPath).filePath("hourlychime/sounds");
-    
-    cfg.audioFilePath = QDir(soundsDir).filePath("gc-chime.mp3");
-    cfg.strikeFilePath = QDir(soundsDir).filePath("gc-chime.mp3");
-    cfg.preludeFilePath = QDir(soundsDir).filePath("gc-prelude.mp3");
+    cfg.audioFilePath = "builtin:gc-chime.mp3";
+    cfg.strikeFilePath = "builtin:gc-chime.mp3";
+    cfg.preludeFilePath = "builtin:gc-prelude.mp3";
 
     return cfg;
 }
 
 AppConfig load() {
-    ensureAssets();
+    TRACE_SCOPE("Config::load");
     AppConfig cfg = getDefaults();
 
     QString configPath = getConfigPath();
@@ -67,27 +78,55 @@ AppConfig load() {
         if (obj.contains("mode")) cfg.mode = obj["mode"].toString();
         if (obj.contains("notes")) cfg.notes = obj["notes"].toString();
         if (obj.contains("note_speed")) cfg.noteSpeed = obj["note_speed"].toDouble();
+        if (obj.contains("reference_pitch") && NoteTable::isSupported(obj["reference_pitch"].toInt()))
+            cfg.referencePitch = obj["reference_pitch"].toInt();
         
         if (obj.contains("audio_file_path") && !obj["audio_file_path"].isNull()) 
-            cfg.audioFilePath = obj["audio_file_path"].toString();
+            cfg.audioFilePath = migrateLegacySound(obj["audio_file_path"].toString());
             
         if (obj.contains("strike_file_path") && !obj["strike_file_path"].isNull()) 
-            cfg.strikeFilePath = obj["strike_file_path"].toString();
+            cfg.strikeFilePath = migrateLegacySound(obj["strike_file_path"].toString());
             
         if (obj.contains("prelude_file_path") && !obj["prelude_file_path"].isNull()) 
-            cfg.preludeFilePath = obj["prelude_file_path"].toString();
+            cfg.preludeFilePath = migrateLegacySound(obj["prelude_file_path"].toString());
             
         if (obj.contains("strike_interval_ms")) cfg.strikeIntervalMs = obj["strike_interval_ms"].toInt();
         if (obj.contains("volume")) cfg.volume = obj["volume"].toDouble();
+        if (obj.contains("cache_rendered_notes")) cfg.cacheRenderedNotes = obj["cache_rendered_notes"].toBool();
+        if (obj.contains("sink_buffer_ms")) cfg.sinkBufferMs = obj["sink_buffer_ms"].toInt();
+        if (obj.contains("update_check_hours")) cfg.updateCheckHours = qMax(0, obj["update_check_hours"].toInt());
+        if (obj.contains("stream_threshold_kb")) cfg.streamThresholdKb = qMax(0, obj["stream_threshold_kb"].toInt());
+        if (obj.contains("stream_buffer_ms")) cfg.streamBufferMs = qBound(250, obj["stream_buffer_ms"].toInt(), 10000);
+        if (obj.contains("normalize_samples")) cfg.normalizeSamples = obj["normalize_samples"].toBool();
     }
     return cfg;
 }
 
+Changes diff(const AppConfig &from, const AppConfig &to) {
+    Changes changes;
+    if (from.mode != to.mode) changes |= ModeChanged;
+    if (from.notes != to.notes || from.noteSpeed != to.noteSpeed
+        || from.referencePitch != to.referencePitch) changes |= NotesChanged;
+    if (from.audioFilePath != to.audioFilePath
+        || from.strikeFilePath != to.strikeFilePath
+        || from.preludeFilePath != to.preludeFilePath) changes |= SamplePathsChanged;
+    if (from.strikeIntervalMs != to.strikeIntervalMs) changes |= StrikeIntervalChanged;
+    if (from.volume != to.volume) changes |= VolumeChanged;
+    if (from.cacheRenderedNotes != to.cacheRenderedNotes) changes |= CacheSettingsChanged;
+    if (from.sinkBufferMs != to.sinkBufferMs) changes |= SinkBufferChanged;
+    if (from.updateCheckHours != to.updateCheckHours) changes |= UpdateCheckChanged;
+    if (from.streamThresholdKb != to.streamThresholdKb
+        || from.streamBufferMs != to.streamBufferMs) changes |= StreamingChanged;
+    if (from.normalizeSamples != to.normalizeSamples) changes |= NormalizeChanged;
+    return changes;
+}
+
 void save(const AppConfig &cfg) {
     QJsonObject obj;
     obj["mode"] = cfg.mode;
     obj["notes"] = cfg.notes;
     obj["note_speed"] = cfg.noteSpeed;
+    obj["reference_pitch"] = cfg.referencePitch;
     
     if (!cfg.audioFilePath.isEmpty()) obj["audio_file_path"] = cfg.audioFilePath;
     else obj["audio_file_path"] = QJsonValue::Null;
@@ -100,8 +139,16 @@ void save(const AppConfig &cfg) {
 
     obj["strike_interval_ms"] = cfg.strikeIntervalMs;
     obj["volume"] = cfg.volume;
+    obj["cache_rendered_notes"] = cfg.cacheRenderedNotes;
+    obj["sink_buffer_ms"] = cfg.sinkBufferMs;
+    obj["update_check_hours"] = cfg.updateCheckHours;
+    obj["stream_threshold_kb"] = cfg.streamThresholdKb;
+    obj["stream_buffer_ms"] = cfg.streamBufferMs;
+    obj["normalize_samples"] = cfg.normalizeSamples;
 
-    QFile file(getConfigPath());
+    QString path = getConfigPath();
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QFile file(path);
     if (file.open(QIODevice::WriteOnly)) {
         file.write(QJsonDocument(obj).toJson(QJsonDocument::Indented));
     }
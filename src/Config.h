@@ -4,27 +4,67 @@
 #include <QString>
 #include <QJsonObject>
 #include <QMetaType>
+#include <QFlags>
 
 namespace Config {
     struct AppConfig {
         QString mode; // "Notes", "File", "GrandfatherClock"
         QString notes;
         float noteSpeed;
+        int referencePitch; // A4 in Hz for Notes mode: 432, 440 or 442
         QString audioFilePath;
         QString strikeFilePath;
         QString preludeFilePath;
-        int strikeIntervalMs;
+        int strikeIntervalMs; // -1 back-to-back, kStrikeIntervalAuto from the strike sample
         float volume;
+        bool cacheRenderedNotes; // keep rendered Notes PCM on disk next to config.json
+        int sinkBufferMs; // audio output buffer; 0 sizes it adaptively
+        int updateCheckHours; // between release checks; 0 disables them
+        int streamThresholdKb; // files larger than this are streamed; 0 never streams
+        int streamBufferMs; // read-ahead, and memory cap, per streamed file
+        bool normalizeSamples; // level chime files by loudness and trim their silence
     };
 }
 
 Q_DECLARE_METATYPE(Config::AppConfig)
 
 namespace Config {
+    // strikeIntervalMs value that spaces strikes by what OnsetDetector
+    // measured in the strike file.
+    constexpr int kStrikeIntervalAuto = -2;
+
+    // Which parts of an AppConfig differ, so only the affected subsystems rebuild.
+    enum Change {
+        ModeChanged = 0x01,
+        NotesChanged = 0x02,
+        SamplePathsChanged = 0x04,
+        StrikeIntervalChanged = 0x08,
+        VolumeChanged = 0x10,
+        CacheSettingsChanged = 0x20,
+        SinkBufferChanged = 0x40,
+        UpdateCheckChanged = 0x80,
+        StreamingChanged = 0x100,
+        NormalizeChanged = 0x200
+    };
+    Q_DECLARE_FLAGS(Changes, Change)
+
     AppConfig load();
     void save(const AppConfig &config);
     QString getConfigPath();
+    // Path of `name` in the cache directory next to config.json.
+    QString cachePath(const QString &name);
+    // Creates the cache directory, but only once the config directory
+    // exists: a fresh install writes nothing until settings are saved.
+    bool makeCacheDir();
     AppConfig getDefaults();
+    Changes diff(const AppConfig &from, const AppConfig &to);
+
+    // Bundled sounds are referred to as "builtin:<file>" and decoded straight
+    // from the application's resources, so nothing is copied to disk.
+    bool isBuiltinSound(const QString &path);
+    QString builtinResourcePath(const QString &path);
 }
 
+Q_DECLARE_OPERATORS_FOR_FLAGS(Config::Changes)
+
 #endif
@@ -1,5 +1,9 @@
 #include "HourlyChime.h"
 #include "SettingsDialog.h"
+#include "Trace.h"
+#include "Oscillator.h"
+#include "StrikePlan.h"
+#include "CaptureSink.h"
 #include <QCoreApplication>
 #include <QDir>
 #include <QStandardPaths>
@@ -7,78 +11,105 @@
 #include <QMediaDevices>
 #include <QAudioDevice>
 #include <QMessageBox>
-#include <QJsonDocument>
-#include <QJsonObject>
 #include <QDesktopServices>
+#include <QFileInfo>
 #include <iostream>
 
+// The device's own format, so the sound server doesn't have to resample or
+// convert every chime. Falls back to 44.1 kHz Int16 stereo when the device
+// reports nothing usable.
+static QAudioFormat negotiateFormat(const QAudioDevice &device)
+{
+    QAudioFormat format = device.preferredFormat();
+    if (!SampleWriter::isSupported(format.sampleFormat())) {
+        format.setSampleFormat(QAudioFormat::Float);
+    }
+    if (format.sampleRate() > 0 && format.channelCount() > 0 && device.isFormatSupported(format)) {
+        return format;
+    }
+
+    QAudioFormat fallback;
+    fallback.setSampleRate(44100);
+    fallback.setChannelCount(2);
+    fallback.setSampleFormat(QAudioFormat::Int16);
+    return fallback;
+}
+
+// Trace event names for sink state transitions.
+static const char *sinkStateName(QAudio::State state)
+{
+    switch (state) {
+    case QAudio::ActiveState: return "sink.Active";
+    case QAudio::SuspendedState: return "sink.Suspended";
+    case QAudio::StoppedState: return "sink.Stopped";
+    case QAudio::IdleState: return "sink.Idle";
+    }
+    return "sink.Unknown";
+}
+
 HourlyChime::HourlyChime(QObject *parent)
+    : HourlyChime(Clock::system(), nullptr, parent)
+{
+}
+
+HourlyChime::HourlyChime(Clock *wallClock, CaptureSink *captureSink, QObject *parent)
     : QObject(parent)
     , trayIcon(nullptr)
     , trayIconMenu(nullptr)
     , updateAction(nullptr)
-    , timer(new QTimer(this))
-    , strikeTimer(new QTimer(this))
+    , clock(wallClock)
+    , scheduler(new ChimeScheduler(clock, this))
     , settingsDialog(nullptr)
-    , preludePlayer(nullptr)
-    , synthSink(nullptr)
-    , synthGenerator(nullptr)
-    , strikesLeft(0)
-    , isPlayingPrelude(false)
-    , networkManager(new QNetworkAccessManager(this))
-{
-    // Initialize Voice Pool (10 voices)
-    for (int i = 0; i < 10; ++i) {
-        auto* out = new QAudioOutput(this);
-        auto* pl = new QMediaPlayer(this);
-        pl->setAudioOutput(out);
-        connect(pl, &QMediaPlayer::playbackStateChanged, this, &HourlyChime::onMediaPlayerStateChanged);
-        voicePool.append(pl);
-        outputPool.append(out);
-    }
-
-    strikeTimer->setSingleShot(true);
-    connect(strikeTimer, &QTimer::timeout, this, &HourlyChime::playNextStrike);
-
-    // Setup Synth
-    QAudioFormat format;
-    format.setSampleRate(44100);
-    format.setChannelCount(2);
-    format.setSampleFormat(QAudioFormat::Int16);
-    
-    synthGenerator = new SynthGenerator(format, this);
-    synthSink = new QAudioSink(format, this);
-    synthSink->setVolume(1.0f);
-    
-    connect(synthSink, &QAudioSink::stateChanged, this, [this](QAudio::State state){
-        if (state == QAudio::IdleState) {
-            emit testFinished();
-        } else if (state == QAudio::StoppedState) {
-            if (this->synthSink->error() != QAudio::NoError) {
-                 qWarning() << "AudioSink error:" << this->synthSink->error();
-            }
-            emit testFinished();
-        }
-    });
+    , updateChecker(new UpdateChecker(this))
+    , capture(captureSink)
+    , sinkOpen(false)
+    , mediaDevices(nullptr)
+    , sinkInUse(false)
+    , chimeUnderrunBase(0)
+    , renderer(nullptr)
+    , sampleCache(new SampleCache(QAudioFormat(), this)) // format set by ensureOutputFormat()
+    , notesCache(new NotesCache(this))
+    , waitingForSamples(false)
+    , latency(clock)
+    , probeVoice(-1)
+    , configLoaded(false)
+    , configWatcher(nullptr)
+    , reloadTimer(new QTimer(this))
+{
+    TRACE_SCOPE("HourlyChime::HourlyChime");
+
+    // Editors often save in several steps; coalesce them into one reload.
+    reloadTimer->setSingleShot(true);
+    reloadTimer->setInterval(250);
+    connect(reloadTimer, &QTimer::timeout, this, &HourlyChime::onWatchedFilesChanged);
+
+    connect(sampleCache, &SampleCache::sampleReady, this, &HourlyChime::onSampleDecoded);
+    connect(sampleCache, &SampleCache::sampleFailed, this, &HourlyChime::onSampleDecoded);
+    connect(sampleCache, &SampleCache::sampleAnalyzed, this, &HourlyChime::onSampleAnalyzed);
+    connect(notesCache, &NotesCache::pcmReady, this, &HourlyChime::onSampleDecoded);
+    connect(updateChecker, &UpdateChecker::updateAvailable, this, &HourlyChime::onUpdateAvailable);
 
     createTrayIcon();
     
-    connect(timer, &QTimer::timeout, this, &HourlyChime::checkTime);
-    timer->start(1000);
-
-    connect(networkManager, &QNetworkAccessManager::finished, this, &HourlyChime::onUpdateCheckFinished);
-    checkForUpdates();
+    connect(scheduler, &ChimeScheduler::hourReached, this, &HourlyChime::onHourReached);
+    {
+        TRACE_SCOPE("ChimeScheduler::start");
+        scheduler->start();
+    }
 
-    reloadConfig();
+    // Audio, decoding and networking are all created on first use.
+    QTimer::singleShot(0, this, &HourlyChime::reloadConfig);
 }
 
 HourlyChime::~HourlyChime()
 {
+    latency.save();
     if (settingsDialog) delete settingsDialog;
 }
 
 void HourlyChime::createTrayIcon()
 {
+    TRACE_SCOPE("HourlyChime::createTrayIcon");
     trayIconMenu = new QMenu();
     
     updateAction = new QAction(tr("Update Available!"), this);
@@ -119,9 +150,25 @@ void HourlyChime::showAbout()
     QString dateStr = QString("Built on: %1").arg(HOURLY_CHIME_DATE_STR);
     
     QString updateMsg;
-    if (!latestVersionStr.isEmpty() && latestVersionStr != versionStr) {
+    if (updateChecker->hasUpdate()) {
         updateMsg = QString("<p><b>Update Available: %1</b><br><a href='%2'>Download Update</a></p>")
-                        .arg(latestVersionStr, latestVersionUrl);
+                        .arg(updateChecker->latestVersion(), updateChecker->latestUrl());
+    }
+
+    QString latencyMsg;
+    if (latency.hasHistory()) {
+        latencyMsg = QString("<h4>Chime Latency</h4><pre>%1</pre>").arg(latency.report().toHtmlEscaped());
+    }
+    if (sinkOpen) {
+        latencyMsg += QString("<p>Output buffer: %1 ms%2, %3 chime(s) with sink underruns</p>")
+                          .arg(bufferPolicy.bufferMs())
+                          .arg(bufferPolicy.isAdaptive() ? " (adaptive)" : "")
+                          .arg(bufferPolicy.underrunChimes());
+    }
+    if (renderer && renderer->underruns() > 0) {
+        latencyMsg += QString("<p>Audio underruns: %1 (%2 frames of silence)</p>")
+                          .arg(renderer->underruns())
+                          .arg(renderer->underrunFrames());
     }
 
     QMessageBox::about(nullptr, tr("About Hourly Chime"), 
@@ -136,51 +183,20 @@ void HourlyChime::showAbout()
            "<p><b>Images:</b><br>"
            "Grandfather Clock Icon - Iconic Panda - Flaticon</p>"
            "<p><b>Sounds:</b><br>"
-           "Default Prelude and Chime - Grandfather clock strikes ten - Pixabay</p>").arg(versionStr, dateStr, updateMsg));
-}
-
-void HourlyChime::checkForUpdates()
-{
-    QNetworkRequest request(QUrl("https://api.github.com/repos/EddieDover/HourlyChime/releases/latest"));
-    request.setHeader(QNetworkRequest::UserAgentHeader, "HourlyChime-App");
-    networkManager->get(request);
+           "Default Prelude and Chime - Grandfather clock strikes ten - Pixabay</p>"
+           "%4").arg(versionStr, dateStr, updateMsg, latencyMsg));
 }
 
-void HourlyChime::onUpdateCheckFinished(QNetworkReply *reply)
+void HourlyChime::onUpdateAvailable(const QString &version)
 {
-    if (reply->error() == QNetworkReply::NoError) {
-        QByteArray data = reply->readAll();
-        QJsonDocument doc = QJsonDocument::fromJson(data);
-        QJsonObject obj = doc.object();
-        
-        QString tagName = obj["tag_name"].toString();
-        // Remove 'v' prefix if present
-        if (tagName.startsWith("v")) {
-            tagName = tagName.mid(1);
-        }
-        
-        QString currentVersion = QString(HOURLY_CHIME_VERSION_STR);
-        if (currentVersion.startsWith("v")) {
-            currentVersion = currentVersion.mid(1);
-        }
-
-        if (tagName != currentVersion && !tagName.isEmpty()) {
-            latestVersionStr = tagName;
-            latestVersionUrl = obj["html_url"].toString();
-            
-            if (updateAction) {
-                updateAction->setText(tr("Update Available (%1)").arg(latestVersionStr));
-                updateAction->setVisible(true);
-            }
-        }
-    }
-    reply->deleteLater();
+    updateAction->setText(tr("Update Available (%1)").arg(version));
+    updateAction->setVisible(true);
 }
 
 void HourlyChime::openUpdateUrl()
 {
-    if (!latestVersionUrl.isEmpty()) {
-        QDesktopServices::openUrl(QUrl(latestVersionUrl));
+    if (!updateChecker->latestUrl().isEmpty()) {
+        QDesktopServices::openUrl(QUrl(updateChecker->latestUrl()));
     }
 }
 
@@ -198,7 +214,9 @@ void HourlyChime::showSettings()
         connect(settingsDialog, &SettingsDialog::configChanged, this, &HourlyChime::reloadConfig);
         connect(settingsDialog, &SettingsDialog::testRequested, this, &HourlyChime::testSound);
         connect(settingsDialog, &SettingsDialog::stopTestRequested, this, &HourlyChime::stopTest);
+        connect(settingsDialog, &SettingsDialog::strikeFileChanged, this, &HourlyChime::onStrikeFileChanged);
         connect(this, &HourlyChime::testFinished, settingsDialog, &SettingsDialog::onTestFinished);
+        onSampleAnalyzed(settingsDialog->strikeFilePath());
     }
     settingsDialog->show();
     settingsDialog->raise();
@@ -207,214 +225,404 @@ void HourlyChime::showSettings()
 
 void HourlyChime::reloadConfig()
 {
-    currentConfig = Config::load();
-    for (auto* out : outputPool) {
-        out->setVolume(currentConfig.volume);
+    TRACE_SCOPE("HourlyChime::reloadConfig");
+    if (!configLoaded) {
+        latency.load();
+    }
+
+    Config::AppConfig cfg = Config::load();
+    Config::Changes changes = configLoaded ? Config::diff(currentConfig, cfg) : ~Config::Changes();
+    currentConfig = cfg;
+    configLoaded = true;
+
+    watchConfigFiles();
+
+    if (changes & Config::SinkBufferChanged) {
+        if (bufferPolicy.setFixedMs(currentConfig.sinkBufferMs) && sinkOpen) {
+            openSink();
+        }
+    }
+
+    // Pre-decoding needs the format the default device will be opened in;
+    // the device itself is only opened for the first chime.
+    if (currentConfig.mode == "Notes" || !samplePaths(currentConfig).isEmpty()) {
+        ensureOutputFormat();
+    }
+
+    if (changes & (Config::ModeChanged | Config::NotesChanged | Config::VolumeChanged | Config::CacheSettingsChanged)) {
+        notesCache->setDiskCacheEnabled(currentConfig.cacheRenderedNotes);
+        if (currentConfig.mode == "Notes") {
+            notesCache->prepare(currentConfig.notes, currentConfig.noteSpeed, currentConfig.volume,
+                                currentConfig.referencePitch, outputFormat);
+        }
+    }
+
+    if (changes & Config::StreamingChanged) {
+        sampleCache->setStreaming(qint64(currentConfig.streamThresholdKb) * 1024, currentConfig.streamBufferMs);
     }
+
+    if (changes & Config::NormalizeChanged) {
+        sampleCache->setNormalize(currentConfig.normalizeSamples);
+    }
+
+    if (changes & (Config::ModeChanged | Config::SamplePathsChanged)) {
+        sampleCache->setPaths(samplePaths(currentConfig), repeatedPaths(currentConfig));
+    }
+
+    if (changes & Config::UpdateCheckChanged) {
+        updateChecker->setIntervalHours(currentConfig.updateCheckHours);
+    }
+}
+
+void HourlyChime::onWatchedFilesChanged()
+{
+    reloadConfig();
+    // Picks up sample files replaced in place under the same path.
+    sampleCache->setPaths(samplePaths(currentConfig), repeatedPaths(currentConfig));
 }
 
-void HourlyChime::checkTime()
+void HourlyChime::watchConfigFiles()
 {
-    static int lastHour = -1;
-    QDateTime now = QDateTime::currentDateTime();
-    int currentHour = now.time().hour();
+    if (!configWatcher) {
+        configWatcher = new QFileSystemWatcher(this);
+        connect(configWatcher, &QFileSystemWatcher::fileChanged, reloadTimer, QOverload<>::of(&QTimer::start));
+        connect(configWatcher, &QFileSystemWatcher::directoryChanged, reloadTimer, QOverload<>::of(&QTimer::start));
+    }
+
+    // The directory is watched too so a config file replaced by rename (or
+    // created for the first time) is noticed and re-added.
+    QString configPath = Config::getConfigPath();
+    QStringList wanted{QFileInfo(configPath).absolutePath(), configPath};
+    for (const QString &path : samplePaths(currentConfig)) {
+        if (!Config::isBuiltinSound(path)) wanted << path;
+    }
 
-    if (lastHour != -1 && currentHour != lastHour) {
-        playChime();
+    QStringList watched = configWatcher->files() + configWatcher->directories();
+    for (const QString &path : watched) {
+        if (!wanted.contains(path)) configWatcher->removePath(path);
+    }
+    for (const QString &path : wanted) {
+        if (!path.isEmpty() && !watched.contains(path) && QFileInfo::exists(path)) {
+            configWatcher->addPath(path);
+        }
     }
-    lastHour = currentHour;
 }
 
-void HourlyChime::playChime()
+QStringList HourlyChime::samplePaths(const Config::AppConfig &config)
 {
-    reloadConfig();
+    QStringList paths;
+    if (config.mode == "File") {
+        paths << config.audioFilePath;
+    } else if (config.mode == "GrandfatherClock") {
+        paths << config.strikeFilePath << config.preludeFilePath;
+    }
+    return paths;
+}
 
-    switch (currentConfig.mode == "File" ? 1 : (currentConfig.mode == "GrandfatherClock" ? 2 : 0)) {
-        case 1:
-            if (!currentConfig.audioFilePath.isEmpty()) {
-                playFile(currentConfig.audioFilePath);
-            }
-            break;
-        case 2:
-            playGrandfatherSequence();
-            break;
-        default:
-            playNotes(currentConfig.notes, currentConfig.noteSpeed, currentConfig.volume);
-            break;
+QStringList HourlyChime::repeatedPaths(const Config::AppConfig &config)
+{
+    QStringList paths;
+    if (config.mode == "GrandfatherClock") {
+        paths << config.strikeFilePath;
     }
+    return paths;
+}
+
+void HourlyChime::onHourReached(const QDateTime &boundary)
+{
+    Trace::instant("hourReached");
+    latency.begin(boundary);
+    playChime();
+}
+
+void HourlyChime::playChime()
+{
+    TRACE_SCOPE("HourlyChime::playChime");
+    // No reload here: currentConfig is kept fresh by the watcher, so the top
+    // of the hour does no filesystem I/O.
+    latency.mark(LatencyProbe::ChimeDispatched);
+    startChime(currentConfig);
 }
 
 void HourlyChime::testSound(const Config::AppConfig &config)
 {
-    for (auto* out : outputPool) {
-        out->setVolume(config.volume);
+    TRACE_SCOPE("HourlyChime::testSound");
+    startChime(config);
+}
+
+void HourlyChime::startChime(const Config::AppConfig &config)
+{
+    activeConfig = config;
+    // Opened here rather than at startup so an idle app holds no audio
+    // stream or render thread. Done before the caches are checked, as a
+    // default device in a new format has them re-decoded.
+    if (!sinkOpen) {
+        openSink();
     }
 
-    if (config.mode == "File") {
-        if (!config.audioFilePath.isEmpty()) {
-            playFile(config.audioFilePath);
-        }
-    } else if (config.mode == "GrandfatherClock") {
-        playGrandfatherSequence();
-    } else if (config.mode == "Notes") {
-        playNotes(config.notes, config.noteSpeed, config.volume);
+    sampleCache->ensure(samplePaths(config), repeatedPaths(config));
+    if (config.mode == "Notes") {
+        notesCache->ensure(config.notes, config.noteSpeed, config.volume, config.referencePitch, outputFormat);
+    }
+    if (isChimePending(config)) {
+        // The config only just changed; play as soon as decoding or rendering lands.
+        Trace::instant("waitingForSamples");
+        waitingForSamples = true;
+        return;
     }
+    dispatchChime();
 }
 
-void HourlyChime::playNotes(const QString &notes, float speed, float volume)
+bool HourlyChime::isChimePending(const Config::AppConfig &config) const
 {
-    qDebug() << "Playing notes:" << notes << "Speed:" << speed << "Volume:" << volume;
-    
-    if (synthSink) {
-        synthSink->stop();
-        delete synthSink;
+    if (config.mode == "Notes") {
+        return notesCache->isPending(config.notes, config.noteSpeed, config.volume, config.referencePitch, outputFormat);
     }
+    return sampleCache->isPending(samplePaths(config));
+}
 
-    QAudioFormat format;
-    format.setSampleRate(44100);
-    format.setChannelCount(2);
-    format.setSampleFormat(QAudioFormat::Int16);
-    
-    synthSink = new QAudioSink(QMediaDevices::defaultAudioOutput(), format, this);
-    synthSink->setVolume(1.0f);
-    
-    connect(synthSink, &QAudioSink::stateChanged, this, [this](QAudio::State state){
-        if (state == QAudio::IdleState) {
-            emit testFinished();
-        } else if (state == QAudio::StoppedState) {
-            if (this->synthSink->error() != QAudio::NoError) {
-                 qWarning() << "AudioSink error:" << this->synthSink->error();
-            }
-            emit testFinished();
-        }
-    });
+void HourlyChime::onSampleDecoded()
+{
+    if (waitingForSamples && !isChimePending(activeConfig)) {
+        waitingForSamples = false;
+        dispatchChime();
+    }
+}
 
-    synthGenerator->setSequence(notes, speed, volume);
-    synthGenerator->start();
-    synthSink->start(synthGenerator);
+void HourlyChime::onSampleAnalyzed(const QString &path)
+{
+    if (settingsDialog && !path.isEmpty() && path == settingsDialog->strikeFilePath()) {
+        settingsDialog->setSuggestedStrikeInterval(static_cast<int>(sampleCache->strikeIntervalUs(path) / 1000));
+    }
+}
+
+void HourlyChime::onStrikeFileChanged(const QString &path)
+{
+    // The analysis comes with the decode and lands in onSampleAnalyzed().
+    if (!path.isEmpty()) {
+        ensureOutputFormat();
+        sampleCache->ensure({path}, {path});
+    }
+    onSampleAnalyzed(path);
 }
 
-QMediaPlayer* HourlyChime::getFreePlayer()
+void HourlyChime::dispatchChime()
 {
-    for (auto* p : voicePool) {
-        if (p->playbackState() == QMediaPlayer::StoppedState) {
-            return p;
+    TRACE_SCOPE("HourlyChime::dispatchChime");
+    latency.mark(LatencyProbe::SamplesReady);
+    probeVoice = -1;
+
+    if (activeConfig.mode == "File") {
+        if (activeConfig.audioFilePath.isEmpty() || playFile(activeConfig.audioFilePath) < 0) {
+            emit testFinished();
         }
+    } else if (activeConfig.mode == "GrandfatherClock") {
+        playGrandfatherSequence();
+    } else {
+        playNotes(activeConfig.notes, activeConfig.noteSpeed, activeConfig.volume, activeConfig.referencePitch);
     }
-    // If all busy, steal the first one (oldest playing usually)
-    if (!voicePool.isEmpty()) {
-        voicePool.first()->stop();
-        return voicePool.first();
+}
+
+AudioRenderer *HourlyChime::ensureRenderer()
+{
+    if (!renderer) {
+        renderer = new AudioRenderer(outputFormat, this);
+        connect(renderer, &AudioRenderer::voiceStarted, this, &HourlyChime::onVoiceStarted);
+        connect(renderer, &AudioRenderer::sinkStateChanged, this, &HourlyChime::onSinkStateChanged);
     }
-    return nullptr;
+    return renderer;
+}
+
+bool HourlyChime::rendererActive() const
+{
+    return renderer && renderer->isActive();
 }
 
-void HourlyChime::playFile(const QString &path)
+void HourlyChime::openSink()
 {
-    QMediaPlayer* p = getFreePlayer();
-    if (!p) return;
+    TRACE_SCOPE("HourlyChime::openSink");
+    if (capture) {
+        setOutputFormat(capture->format());
+        ensureRenderer()->openCapture(capture);
+        sinkOpen = true;
+        return;
+    }
 
-    if (isPlayingPrelude) {
-        preludePlayer = p;
+    if (!mediaDevices) {
+        mediaDevices = new QMediaDevices(this);
+        connect(mediaDevices, &QMediaDevices::audioOutputsChanged, this, &HourlyChime::onAudioOutputsChanged);
     }
 
-    p->audioOutput()->setDevice(QMediaDevices::defaultAudioOutput());
-    p->setSource(QUrl::fromLocalFile(path));
-    p->play();
+    sinkDevice = QMediaDevices::defaultAudioOutput();
+    setOutputFormat(negotiateFormat(sinkDevice));
+    // Replaces the renderer's previous sink, if it kept the renderer.
+    ensureRenderer()->openSink(sinkDevice, bufferPolicy.bufferBytes(outputFormat));
+    sinkOpen = true;
 }
 
-void HourlyChime::playGrandfatherSequence()
+void HourlyChime::ensureOutputFormat()
 {
-    QDateTime now = QDateTime::currentDateTime();
-    int hour = now.time().hour();
-    if (hour == 0) hour = 12;
-    if (hour > 12) hour -= 12;
+    if (outputFormat.isValid()) return;
+    setOutputFormat(capture ? capture->format() : negotiateFormat(QMediaDevices::defaultAudioOutput()));
+}
 
-    strikesLeft = hour;
-    isPlayingPrelude = true;
-    preludePlayer = nullptr;
+void HourlyChime::setOutputFormat(const QAudioFormat &format)
+{
+    if (format == outputFormat) return;
+    qInfo() << "Output format:" << format.sampleRate() << "Hz," << format.channelCount() << "channel(s),"
+            << format.sampleFormat();
+    outputFormat = format;
+
+    // The mixer and ring are built for one format, so a new device with a
+    // different one cuts a chime in progress. The old sink goes with them.
+    if (renderer) {
+        renderer->stopAll();
+        renderer->deleteLater();
+        renderer = nullptr;
+    }
 
-    if (!currentConfig.preludeFilePath.isEmpty()) {
-        playFile(currentConfig.preludeFilePath);
-    } else {
-        isPlayingPrelude = false;
-        playNextStrike();
+    sampleCache->setFormat(format);
+    if (configLoaded && currentConfig.mode == "Notes") {
+        notesCache->setDiskCacheEnabled(currentConfig.cacheRenderedNotes);
+        notesCache->prepare(currentConfig.notes, currentConfig.noteSpeed, currentConfig.volume,
+                            currentConfig.referencePitch, format);
     }
 }
 
-void HourlyChime::stopTest()
+void HourlyChime::onAudioOutputsChanged()
 {
-    strikesLeft = 0;
-    isPlayingPrelude = false;
-    preludePlayer = nullptr;
-    strikeTimer->stop();
-    for (auto* p : voicePool) {
-        p->stop();
+    if (sinkOpen && QMediaDevices::defaultAudioOutput() != sinkDevice) {
+        qDebug() << "Default audio output changed, reopening sink";
+        // The renderer keeps its voice positions, so a chime in progress carries
+        // on from where it was on the new device.
+        openSink();
     }
-    if (synthSink) synthSink->stop();
-    emit testFinished();
 }
 
-void HourlyChime::onMediaPlayerStateChanged(QMediaPlayer::PlaybackState state)
+void HourlyChime::ensureSinkRunning()
 {
-    if (state == QMediaPlayer::StoppedState) {
-        if (currentConfig.mode == "GrandfatherClock") {
-            if (isPlayingPrelude && sender() == preludePlayer) {
-                isPlayingPrelude = false;
-                preludePlayer = nullptr;
-                playNextStrike();
-                return;
-            }
+    TRACE_SCOPE("HourlyChime::ensureSinkRunning");
+    if (!sinkOpen) {
+        openSink();
+    }
 
-            // If interval is disabled (-1), play next strike when current one finishes
-            if (currentConfig.strikeIntervalMs == -1 && !isPlayingPrelude) {
-                if (strikesLeft > 0) {
-                    playNextStrike();
-                    return;
-                }
-            }
-            
-            
-            bool anyPlaying = false;
-            for (auto* p : voicePool) {
-                if (p->playbackState() != QMediaPlayer::StoppedState) {
-                    anyPlaying = true;
-                    break;
-                }
-            }
-            
-            if (!anyPlaying && strikesLeft == 0 && !isPlayingPrelude) {
-                emit testFinished();
-            }
-        } else {
-            bool anyPlaying = false;
-            for (auto* p : voicePool) {
-                if (p->playbackState() != QMediaPlayer::StoppedState) {
-                    anyPlaying = true;
-                    break;
-                }
+    if (!sinkInUse) {
+        sinkInUse = true;
+        chimeUnderrunBase = renderer->underruns();
+    }
+    renderer->resumeSink();
+    latency.mark(LatencyProbe::SinkStarted);
+}
+
+void HourlyChime::onSinkStateChanged(QAudio::State state, QAudio::Error error)
+{
+    // Ignores a renderer replaced since it sent this.
+    if (sender() != renderer) return;
+    Trace::instant(sinkStateName(state), error);
+
+    if (state == QAudio::StoppedState && error != QAudio::NoError) {
+        // The renderer closed it; reopened on the next chime, possibly on a
+        // different device.
+        sinkOpen = false;
+    }
+
+    if (state == QAudio::IdleState) {
+        // The renderer pads any shortfall while voices are playing, so this
+        // only happens with one queued since the sink ran dry.
+        if (rendererActive()) return;
+
+        // Nothing left to mix; keep the stream open but stop it pulling.
+        renderer->suspendSink();
+        emit testFinished();
+        if (sinkInUse) {
+            sinkInUse = false;
+            // Starvation shows up as silence the renderer had to pad in.
+            if (renderer->underruns() > chimeUnderrunBase) {
+                bufferPolicy.noteUnderrun();
             }
-            if (!anyPlaying) {
-                emit testFinished();
+            if (bufferPolicy.chimeFinished()) {
+                // Resized while idle, so the next chime gets the new buffer.
+                openSink();
             }
         }
     }
 }
 
-void HourlyChime::playNextStrike()
+void HourlyChime::playNotes(const QString &notes, float speed, float volume, int referenceHz)
 {
-    if (!currentConfig.strikeFilePath.isEmpty()) {
-        playFile(currentConfig.strikeFilePath);
+    TRACE_SCOPE("HourlyChime::playNotes");
+    qDebug() << "Playing notes:" << notes << "Speed:" << speed << "Volume:" << volume;
+
+    // Volume is baked into the rendered PCM.
+    int voice = ensureRenderer()->play(notesCache->takePcm(notes, speed, volume, referenceHz, outputFormat), 1.0f);
+    if (voice < 0) {
+        emit testFinished();
+        return;
     }
+    if (latency.isOpen() && probeVoice < 0) probeVoice = voice;
+    ensureSinkRunning();
+}
 
-    if (currentConfig.strikeIntervalMs >= 0) {
-        if (strikesLeft > 1) {
-            strikesLeft--;
-            strikeTimer->start(currentConfig.strikeIntervalMs);
-        } else {
-            strikesLeft = 0;
+int HourlyChime::playFile(const QString &path, qint64 delayFrames)
+{
+    TRACE_SCOPE("HourlyChime::playFile", delayFrames);
+    // Long files come from a pre-rolled stream rather than memory.
+    const float gain = activeConfig.volume * sampleCache->gain(path);
+    int voice = sampleCache->isStreamed(path)
+        ? ensureRenderer()->play(sampleCache->takeStream(path), gain, delayFrames)
+        : ensureRenderer()->play(sampleCache->pcm(path), gain, delayFrames);
+    if (voice < 0) {
+        qWarning() << "No decoded audio for" << path;
+        return -1;
+    }
+    if (latency.isOpen() && probeVoice < 0) probeVoice = voice;
+    ensureSinkRunning();
+    return voice;
+}
+
+void HourlyChime::playGrandfatherSequence()
+{
+    TRACE_SCOPE("HourlyChime::playGrandfatherSequence");
+    // Lengths are read before anything plays: taking a stream re-rolls it.
+    const StrikePlan plan = StrikePlan::make(activeConfig, clock->now(), outputFormat, *sampleCache);
+
+    // The whole sequence is queued on the renderer at once, with each strike's
+    // start given in frames, so spacing never depends on the event loop.
+    bool preludePlayed = false;
+    bool queued = false;
+
+    if (!activeConfig.preludeFilePath.isEmpty()) {
+        preludePlayed = playFile(activeConfig.preludeFilePath) >= 0;
+        queued = preludePlayed;
+    }
+
+    if (!activeConfig.strikeFilePath.isEmpty()) {
+        for (int k = 0; k < plan.strikes; ++k) {
+            if (playFile(activeConfig.strikeFilePath, plan.strikeOffset(k, preludePlayed)) < 0) break;
+            queued = true;
         }
-    } else {
-        if (strikesLeft > 0) strikesLeft--;
+    }
+
+    if (!queued) {
+        emit testFinished();
+    }
+}
+
+void HourlyChime::stopTest()
+{
+    waitingForSamples = false;
+    if (renderer) {
+        renderer->stopAll();
+        // Drop whatever is already queued in the backend, then re-warm.
+        renderer->flushSink();
+    }
+    emit testFinished();
+}
+
+void HourlyChime::onVoiceStarted(int id, qint64 steadyNs)
+{
+    if (id == probeVoice) {
+        latency.mark(LatencyProbe::FirstSample, steadyNs);
+        probeVoice = -1;
     }
 }
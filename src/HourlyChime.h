@@ -5,16 +5,22 @@
 #include <QSystemTrayIcon>
 #include <QMenu>
 #include <QTimer>
-#include <QMediaPlayer>
-#include <QAudioOutput>
+#include <QFileSystemWatcher>
 #include <QSettings>
 #include <QDateTime>
-#include <QAudioSink>
-#include <QNetworkAccessManager>
-#include <QNetworkReply>
+#include <QAudioDevice>
+#include <QMediaDevices>
 #include "Config.h"
-#include "SynthGenerator.h"
+#include "NotesCache.h"
+#include "SampleCache.h"
+#include "AudioRenderer.h"
+#include "SinkBufferPolicy.h"
+#include "ChimeScheduler.h"
+#include "Clock.h"
+#include "LatencyProbe.h"
+#include "UpdateChecker.h"
 
+class CaptureSink;
 class SettingsDialog;
 
 class HourlyChime : public QObject
@@ -23,9 +29,14 @@ class HourlyChime : public QObject
 
 public:
     explicit HourlyChime(QObject *parent = nullptr);
+    // Reads the time from `wallClock` and, if `captureSink` is set, plays into
+    // it in its format instead of the default audio output. For tests.
+    HourlyChime(Clock *wallClock, CaptureSink *captureSink, QObject *parent = nullptr);
     ~HourlyChime();
 
     void showSettings();
+    // With a virtual clock, whoever advances it wakes the scheduler.
+    ChimeScheduler *chimeScheduler() const { return scheduler; }
 
 signals:
     void testFinished();
@@ -35,53 +46,80 @@ public slots:
     void stopTest();
 
 private slots:
-    void checkTime();
+    void onHourReached(const QDateTime &boundary);
     void playChime();
-    void onMediaPlayerStateChanged(QMediaPlayer::PlaybackState state);
+    void onVoiceStarted(int id, qint64 steadyNs);
+    void onSinkStateChanged(QAudio::State state, QAudio::Error error);
+    void onAudioOutputsChanged();
+    void onSampleDecoded();
+    void onSampleAnalyzed(const QString &path);
+    void onStrikeFileChanged(const QString &path);
     void iconActivated(QSystemTrayIcon::ActivationReason reason);
     void reloadConfig();
+    void onWatchedFilesChanged();
     void showAbout();
-    void checkForUpdates();
-    void onUpdateCheckFinished(QNetworkReply *reply);
+    void onUpdateAvailable(const QString &version);
     void openUpdateUrl();
 
 private:
     void createTrayIcon();
+    void watchConfigFiles();
     
     // Audio helpers
-    void playFile(const QString &path);
+    void startChime(const Config::AppConfig &config);
+    bool isChimePending(const Config::AppConfig &config) const;
+    void dispatchChime();
+    AudioRenderer *ensureRenderer();
+    bool rendererActive() const;
+    void openSink();
+    // Settles the format from the default device without opening it.
+    void ensureOutputFormat();
+    void setOutputFormat(const QAudioFormat &format);
+    void ensureSinkRunning();
+    int playFile(const QString &path, qint64 delayFrames = 0);
     void playGrandfatherSequence();
-    void playNextStrike();
-    void playNotes(const QString &notes, float speed, float volume);
+    void playNotes(const QString &notes, float speed, float volume, int referenceHz);
+    static QStringList samplePaths(const Config::AppConfig &config);
+    // Of samplePaths(), those played more than once per chime.
+    static QStringList repeatedPaths(const Config::AppConfig &config);
     
     QSystemTrayIcon *trayIcon;
     QMenu *trayIconMenu;
     QAction *updateAction;
-    QTimer *timer;
-    QTimer *strikeTimer;
+    Clock *clock; // all wall-clock reads, so they can be simulated
+    ChimeScheduler *scheduler;
     SettingsDialog *settingsDialog;
 
     // Network
-    QNetworkAccessManager *networkManager;
-    QString latestVersionUrl;
-    QString latestVersionStr;
+    UpdateChecker *updateChecker;
 
-    // Audio
-    QList<QMediaPlayer*> voicePool;
-    QList<QAudioOutput*> outputPool;
-    QMediaPlayer* getFreePlayer();
-    QMediaPlayer* preludePlayer;
-    
-    // Synth
-    QAudioSink *synthSink;
-    SynthGenerator *synthGenerator;
-    
-    // Grandfather clock state
-    int strikesLeft;
-    bool isPlayingPrelude;
+    // Audio: every chime is mixed into one long-lived sink on the renderer's
+    // thread, kept suspended between chimes and only reopened when the
+    // default output changes
+    CaptureSink *capture; // replaces the audio device when set
+    bool sinkOpen;
+    QAudioDevice sinkDevice;
+    QAudioFormat outputFormat; // negotiated with sinkDevice; all PCM is kept in it
+    QMediaDevices *mediaDevices;
+    SinkBufferPolicy bufferPolicy;
+    bool sinkInUse; // a chime has resumed the sink since it last went idle
+    quint64 chimeUnderrunBase; // renderer underruns when the current chime began
+    AudioRenderer *renderer;
+    SampleCache *sampleCache;
+    NotesCache *notesCache;
+    bool waitingForSamples;
+
+    // Hour-to-first-sample instrumentation
+    LatencyProbe latency;
+    int probeVoice;
 
-    // Config cache
+    // Config cache, refreshed only when the files change or settings are saved
     Config::AppConfig currentConfig;
+    bool configLoaded;
+    QFileSystemWatcher *configWatcher;
+    QTimer *reloadTimer;
+    // Config of the chime being played: the saved one, or a test's
+    Config::AppConfig activeConfig;
 };
 
 #endif // HOURLYCHIME_H
@@ -0,0 +1,206 @@
+#include "LatencyProbe.h"
+#include "Config.h"
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+#include <QDebug>
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+
+namespace {
+
+const char *kStageNames[LatencyProbe::StageCount] = {
+    "timer", "dispatch", "samples", "sink_start", "first_sample"
+};
+
+qint64 percentile(QVector<qint64> values, double p)
+{
+    std::sort(values.begin(), values.end());
+    int index = qBound(0, static_cast<int>(p * (values.size() - 1) + 0.5), static_cast<int>(values.size()) - 1);
+    return values.at(index);
+}
+
+}
+
+LatencyProbe::LatencyProbe(Clock *clock)
+    : m_clock(clock)
+    , m_timerSteadyNs(0)
+    , m_unsaved(0)
+    , m_open(false)
+{
+    m_current.boundaryMs = 0;
+    std::fill(std::begin(m_current.stageUs), std::end(m_current.stageUs), -1);
+}
+
+qint64 LatencyProbe::steadyNowNs()
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void LatencyProbe::begin(const QDateTime &boundary)
+{
+    m_timerSteadyNs = steadyNowNs();
+    const qint64 wallUs = m_clock->nowUs();
+
+    m_current.boundaryMs = boundary.toMSecsSinceEpoch();
+    std::fill(std::begin(m_current.stageUs), std::end(m_current.stageUs), -1);
+    m_current.stageUs[TimerFired] = wallUs - m_current.boundaryMs * 1000;
+    m_open = true;
+}
+
+void LatencyProbe::mark(Stage stage, qint64 steadyNs)
+{
+    if (!m_open || m_current.stageUs[stage] >= 0) return;
+
+    if (steadyNs < 0) steadyNs = steadyNowNs();
+    m_current.stageUs[stage] = m_current.stageUs[TimerFired] + (steadyNs - m_timerSteadyNs) / 1000;
+
+    if (stage == FirstSample) {
+        finish();
+    }
+}
+
+void LatencyProbe::finish()
+{
+    m_open = false;
+    m_history.append(m_current);
+    if (m_history.size() > kMaxHistory) {
+        m_history.remove(0, m_history.size() - kMaxHistory);
+    }
+
+    QStringList parts;
+    for (int s = 0; s < StageCount; ++s) {
+        parts << QString("%1=%2ms").arg(kStageNames[s]).arg(m_current.stageUs[s] / 1000.0, 0, 'f', 1);
+    }
+    qInfo().noquote() << "Chime latency since boundary:" << parts.join(' ');
+
+    if (++m_unsaved >= kSaveEvery) save();
+}
+
+QString LatencyProbe::report() const
+{
+    if (m_history.isEmpty()) {
+        return QString("No chimes recorded yet.");
+    }
+
+    struct Row {
+        const char *label;
+        int from; // -1 measures from the boundary
+        int to;
+    };
+    static const Row rows[] = {
+        {"Timer fire vs :00:00", -1, TimerFired},
+        {"Dispatch", TimerFired, ChimeDispatched},
+        {"Samples ready", ChimeDispatched, SamplesReady},
+        {"Sink start", SamplesReady, SinkStarted},
+        {"First sample", SinkStarted, FirstSample},
+        {"Total", -1, FirstSample},
+    };
+
+    QString text;
+    QTextStream out(&text);
+    out << "Chimes recorded: " << m_history.size() << "\n";
+    out << QString::asprintf("%-22s %9s %9s %9s\n", "Stage (ms)", "p50", "p95", "max");
+
+    for (const Row &row : rows) {
+        QVector<qint64> values;
+        for (const Record &r : m_history) {
+            qint64 end = r.stageUs[row.to];
+            qint64 start = row.from < 0 ? 0 : r.stageUs[row.from];
+            if (end >= 0 && start >= 0) values.append(end - start);
+        }
+        if (values.isEmpty()) continue;
+        out << QString::asprintf("%-22s %9.1f %9.1f %9.1f\n", row.label,
+                                 percentile(values, 0.5) / 1000.0,
+                                 percentile(values, 0.95) / 1000.0,
+                                 *std::max_element(values.cbegin(), values.cend()) / 1000.0);
+    }
+
+    static const int bucketsMs[] = {1, 2, 5, 10, 25, 50, 100, 250, 500, 1000};
+    int counts[std::size(bucketsMs) + 1] = {};
+    for (const Record &r : m_history) {
+        if (r.stageUs[FirstSample] < 0) continue;
+        qint64 ms = r.stageUs[FirstSample] / 1000;
+        size_t bucket = 0;
+        while (bucket < std::size(bucketsMs) && ms > bucketsMs[bucket]) ++bucket;
+        counts[bucket]++;
+    }
+
+    out << "\nTotal latency histogram:\n";
+    for (size_t i = 0; i <= std::size(bucketsMs); ++i) {
+        QString label = i < std::size(bucketsMs) ? QString("<= %1 ms").arg(bucketsMs[i])
+                                                 : QString("> %1 ms").arg(bucketsMs[i - 1]);
+        out << QString::asprintf("%-12s %5d\n", qPrintable(label), counts[i]);
+    }
+    return text;
+}
+
+QString LatencyProbe::statsPath()
+{
+    return Config::cachePath("latency.json");
+}
+
+void LatencyProbe::load()
+{
+    QFile file(statsPath());
+    if (!file.open(QIODevice::ReadOnly)) return;
+
+    m_history.clear();
+    m_unsaved = 0;
+    const QJsonArray records = QJsonDocument::fromJson(file.readAll()).object()["records"].toArray();
+    for (const QJsonValue &value : records) {
+        QJsonObject obj = value.toObject();
+        QJsonArray stages = obj["stages_us"].toArray();
+        if (stages.size() != StageCount) continue;
+
+        Record r;
+        r.boundaryMs = obj["boundary_ms"].toInteger();
+        for (int s = 0; s < StageCount; ++s) {
+            r.stageUs[s] = stages.at(s).toInteger(-1);
+        }
+        m_history.append(r);
+    }
+}
+
+void LatencyProbe::save()
+{
+    if (m_unsaved == 0 || !Config::makeCacheDir()) return;
+
+    QJsonArray records;
+    for (const Record &r : m_history) {
+        QJsonArray stages;
+        for (qint64 us : r.stageUs) stages.append(us);
+        QJsonObject obj;
+        obj["boundary_ms"] = r.boundaryMs;
+        obj["stages_us"] = stages;
+        records.append(obj);
+    }
+
+    QFile file(statsPath());
+    if (file.open(QIODevice::WriteOnly)) {
+        QJsonObject root;
+        root["records"] = records;
+        file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+        m_unsaved = 0;
+    }
+}
+
+bool LatencyProbe::requested(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        if (qstrcmp(argv[i], "--latency") == 0) return true;
+    }
+    return false;
+}
+
+int LatencyProbe::run()
+{
+    LatencyProbe probe;
+    probe.load();
+    QTextStream(stdout) << probe.report();
+    return 0;
+}
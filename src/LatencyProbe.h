@@ -0,0 +1,69 @@
+#ifndef LATENCYPROBE_H
+#define LATENCYPROBE_H
+
+#include <QDateTime>
+#include <QString>
+#include <QVector>
+#include "Clock.h"
+
+// Timestamps each stage between the hour boundary and the first sample being
+// pulled by the sink, and keeps a rolling history on disk so late chimes can
+// be attributed to the timer, sample decoding or backend stream setup.
+class LatencyProbe
+{
+public:
+    enum Stage {
+        TimerFired,
+        ChimeDispatched,
+        SamplesReady,
+        SinkStarted,
+        FirstSample,
+        StageCount
+    };
+
+    // `clock` gives the wall time the timer fired at, against the boundary.
+    explicit LatencyProbe(Clock *clock = Clock::system());
+
+    // Opens a trace for the chime scheduled at `boundary`.
+    void begin(const QDateTime &boundary);
+    // Records `stage` at `steadyNs` (now if negative); later marks of the
+    // same stage are ignored. FirstSample closes the trace.
+    void mark(Stage stage, qint64 steadyNs = -1);
+    bool isOpen() const { return m_open; }
+
+    bool hasHistory() const { return !m_history.isEmpty(); }
+    QString report() const;
+
+    void load();
+    // Writes the history if it has chimes that aren't on disk yet. Called on
+    // quit; during the run the history is only written once a day's worth of
+    // chimes has built up, so the hour boundary never waits on the disk.
+    void save();
+
+    static qint64 steadyNowNs();
+    static QString statsPath();
+
+    // Headless `--latency` mode: prints the saved report and exits.
+    static bool requested(int argc, char *argv[]);
+    static int run();
+
+private:
+    static constexpr int kMaxHistory = 24 * 14;
+    static constexpr int kSaveEvery = 24;
+
+    struct Record {
+        qint64 boundaryMs;
+        qint64 stageUs[StageCount]; // since the boundary, -1 if not reached
+    };
+
+    void finish();
+
+    Clock *m_clock;
+    QVector<Record> m_history;
+    Record m_current;
+    qint64 m_timerSteadyNs;
+    int m_unsaved;
+    bool m_open;
+};
+
+#endif // LATENCYPROBE_H
@@ -0,0 +1,205 @@
+#include "Mixer.h"
+#include "Trace.h"
+#include <algorithm>
+
+Mixer::Mixer(const QAudioFormat &format, QObject *parent)
+    : QIODevice(parent)
+    , m_format(format)
+    , m_bytesPerSample(format.bytesPerSample())
+    , m_accumulate(SampleWriter::accumulator(format.sampleFormat()))
+    , m_write(SampleWriter::interleavedWriter(format.sampleFormat()))
+    , m_accum(kBlockFrames * format.channelCount())
+    , m_framesRead(0)
+    , m_streamBlock(kBlockFrames * format.bytesPerFrame(), Qt::Uninitialized)
+{
+    Q_ASSERT(m_accumulate && m_write);
+    for (Voice &v : m_voices) {
+        v.position = 0;
+        v.delay = 0;
+        v.gain = 0.0f;
+        v.id = 0;
+        v.active = false;
+    }
+}
+
+void Mixer::play(int id, const QByteArray &pcm, float gain, qint64 delayFrames)
+{
+    if (pcm.isEmpty()) return;
+
+    Voice &slot = allocate(id, gain, delayFrames);
+    slot.pcm = pcm;
+}
+
+void Mixer::play(int id, const SampleStreamPtr &stream, float gain, qint64 delayFrames)
+{
+    if (!stream) return;
+
+    Voice &slot = allocate(id, gain, delayFrames);
+    slot.stream = stream;
+}
+
+Mixer::Voice &Mixer::allocate(int id, float gain, qint64 delayFrames)
+{
+    Voice *slot = nullptr;
+    for (Voice &v : m_voices) {
+        if (!v.active) {
+            slot = &v;
+            break;
+        }
+        if (!slot || v.id < slot->id) slot = &v;
+    }
+
+    if (slot->active) {
+        int stolen = slot->id;
+        QMetaObject::invokeMethod(this, [this, stolen]() { emit voiceFinished(stolen); }, Qt::QueuedConnection);
+    }
+
+    release(*slot);
+    slot->position = 0;
+    slot->delay = qMax<qint64>(0, delayFrames);
+    slot->gain = gain;
+    slot->id = id;
+    slot->active = true;
+    return *slot;
+}
+
+void Mixer::release(Voice &v)
+{
+    v.active = false;
+    v.pcm.clear();
+    if (v.stream) {
+        v.stream->cancel();
+        v.stream.reset();
+    }
+}
+
+void Mixer::stopAll()
+{
+    for (Voice &v : m_voices) {
+        release(v);
+    }
+}
+
+bool Mixer::isActive() const
+{
+    for (const Voice &v : m_voices) {
+        if (v.active) return true;
+    }
+    return false;
+}
+
+qint64 Mixer::framesRemaining() const
+{
+    qint64 remaining = 0;
+    for (const Voice &v : m_voices) {
+        if (!v.active) continue;
+        if (v.stream) {
+            // Until the decoder is done the end is unknown; keep mixing a block
+            // at a time, in silence if it has fallen behind.
+            const qint64 buffered = v.stream->ring().readAvailable() / m_format.bytesPerFrame();
+            remaining = qMax(remaining, v.delay + (v.stream->isFinished() ? buffered : qMax<qint64>(buffered, kBlockFrames)));
+        } else {
+            remaining = qMax(remaining, v.delay + (v.pcm.size() - v.position) / m_format.bytesPerFrame());
+        }
+    }
+    return remaining;
+}
+
+qint64 Mixer::readData(char *data, qint64 maxlen)
+{
+    const int channels = m_format.channelCount();
+    const int bytesPerFrame = m_format.bytesPerFrame();
+
+    // Stop exactly where the longest voice ends so the sink goes idle.
+    qint64 frames = qMin(maxlen / bytesPerFrame, framesRemaining());
+    if (frames <= 0 || !m_write) return 0;
+    TRACE_SCOPE("Mixer::readData", frames);
+
+    char *out = data;
+    float *accum = m_accum.data();
+    int started[kMaxVoices];
+    qint64 startedAt[kMaxVoices];
+    int startedCount = 0;
+    int finished[kMaxVoices];
+    int finishedCount = 0;
+
+    for (qint64 done = 0; done < frames; ) {
+        const int block = static_cast<int>(qMin<qint64>(frames - done, kBlockFrames));
+        const int samples = block * channels;
+        std::fill(accum, accum + samples, 0.0f);
+
+        for (Voice &v : m_voices) {
+            if (!v.active) continue;
+
+            int offset = 0;
+            if (v.delay > 0) {
+                if (v.delay >= block) {
+                    v.delay -= block;
+                    continue;
+                }
+                offset = static_cast<int>(v.delay) * channels;
+                v.delay = 0;
+            }
+            const bool first = v.position == 0;
+            bool ended = false;
+            qint64 consumed = 0;
+            if (v.stream) {
+                // Checked before reading so data written just before finish() isn't missed.
+                const bool streamFinished = v.stream->isFinished();
+                RingBuffer &ring = v.stream->ring();
+                qint64 buffered = ring.readAvailable();
+                buffered -= buffered % bytesPerFrame;
+                consumed = ring.read(m_streamBlock.data(), qMin<qint64>(qint64(samples - offset) * m_bytesPerSample, buffered));
+                m_accumulate(m_streamBlock.constData(), accum + offset, static_cast<int>(consumed / m_bytesPerSample), v.gain);
+                ended = streamFinished && consumed == buffered;
+            } else {
+                const int n = static_cast<int>(qMin<qint64>(samples - offset, (v.pcm.size() - v.position) / m_bytesPerSample));
+                m_accumulate(v.pcm.constData() + v.position, accum + offset, n, v.gain);
+                consumed = qint64(n) * m_bytesPerSample;
+                ended = v.position + consumed >= v.pcm.size();
+            }
+
+            v.position += consumed;
+            if (first && consumed > 0) {
+                started[startedCount] = v.id;
+                startedAt[startedCount++] = m_framesRead + done + offset / channels;
+            }
+            if (ended) {
+                release(v);
+                finished[finishedCount++] = v.id;
+            }
+        }
+
+        m_write(accum, out, samples);
+
+        out += samples * m_bytesPerSample;
+        done += block;
+    }
+
+    // Deferred so listeners can start new voices without re-entering readData.
+    for (int i = 0; i < startedCount; ++i) {
+        const int id = started[i];
+        const qint64 frame = startedAt[i];
+        Trace::instant("voiceStarted", id);
+        QMetaObject::invokeMethod(this, [this, id, frame]() { emit voiceStarted(id, frame); }, Qt::QueuedConnection);
+    }
+    for (int i = 0; i < finishedCount; ++i) {
+        int id = finished[i];
+        QMetaObject::invokeMethod(this, [this, id]() { emit voiceFinished(id); }, Qt::QueuedConnection);
+    }
+
+    m_framesRead += frames;
+    return frames * bytesPerFrame;
+}
+
+qint64 Mixer::writeData(const char *data, qint64 len)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(len);
+    return 0;
+}
+
+qint64 Mixer::bytesAvailable() const
+{
+    return framesRemaining() * m_format.bytesPerFrame() + QIODevice::bytesAvailable();
+}
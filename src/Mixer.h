@@ -0,0 +1,75 @@
+#ifndef MIXER_H
+#define MIXER_H
+
+#include <QIODevice>
+#include <QAudioFormat>
+#include <QByteArray>
+#include <QVector>
+#include "Oscillator.h"
+#include "SampleStream.h"
+
+// Sums a fixed number of in-memory PCM voices into one stream so every
+// chime shares a single QAudioSink. Voices hold an implicitly shared copy of
+// their sample data, so starting one never copies the PCM. Voice data and
+// output are both in the mixer's format: Int16, Int32 or Float.
+class Mixer : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    static constexpr int kMaxVoices = 16;
+
+    explicit Mixer(const QAudioFormat &format, QObject *parent = nullptr);
+
+    // Starts voice `id`; ids must increase. When all voices are busy the
+    // oldest one is stolen. A voice with `delayFrames` starts that many frames
+    // after the last frame already read, so sequences scheduled in one go stay
+    // sample-accurate whatever the event loop is doing.
+    void play(int id, const QByteArray &pcm, float gain, qint64 delayFrames = 0);
+    // Same, for a voice fed by a streaming decoder. If the decoder falls
+    // behind the voice plays silence until it catches up. Stopping or
+    // stealing the voice cancels the stream.
+    void play(int id, const SampleStreamPtr &stream, float gain, qint64 delayFrames = 0);
+    void stopAll();
+    bool isActive() const;
+
+    bool isSequential() const override { return true; }
+    qint64 readData(char *data, qint64 maxlen) override;
+    qint64 writeData(const char *data, qint64 len) override;
+    qint64 bytesAvailable() const override;
+
+signals:
+    // Both are delivered queued. voiceStarted carries the output frame, as
+    // counted from the first readData(), at which the voice's first sample
+    // was mixed.
+    void voiceStarted(int id, qint64 frame);
+    void voiceFinished(int id);
+
+private:
+    static constexpr int kBlockFrames = 512;
+
+    struct Voice {
+        QByteArray pcm;
+        SampleStreamPtr stream; // instead of pcm
+        qint64 position; // bytes consumed
+        qint64 delay; // frames of silence before the first sample
+        float gain;
+        int id;
+        bool active;
+    };
+
+    Voice &allocate(int id, float gain, qint64 delayFrames);
+    void release(Voice &v);
+    qint64 framesRemaining() const;
+
+    QAudioFormat m_format;
+    int m_bytesPerSample;
+    SampleWriter::Accumulator m_accumulate;
+    SampleWriter::InterleavedWriter m_write;
+    Voice m_voices[kMaxVoices];
+    QVector<float> m_accum;
+    qint64 m_framesRead; // output frames produced so far
+    QByteArray m_streamBlock; // one block read out of a stream's ring
+};
+
+#endif // MIXER_H
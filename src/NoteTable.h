@@ -0,0 +1,65 @@
+#ifndef NOTETABLE_H
+#define NOTETABLE_H
+
+#include <array>
+
+// Equal-tempered frequencies for every MIDI note, built at compile time for
+// each supported A4 reference so turning a note into Hz is a table read.
+namespace NoteTable {
+
+constexpr int kNoteCount = 128;
+constexpr int kA4 = 69;
+constexpr int kDefaultReference = 440;
+constexpr int kSupportedReferences[] = {432, 440, 442};
+
+constexpr std::array<float, kNoteCount> build(int referenceHz)
+{
+    // 2^(k/12) within one octave; whole octaves are exact factors of two.
+    constexpr double kSemitoneRatio[12] = {
+        1.0, 1.0594630943592953, 1.1224620483093730, 1.1892071150027210,
+        1.2599210498948732, 1.3348398541700344, 1.4142135623730951, 1.4983070768766815,
+        1.5874010519681994, 1.6817928305074290, 1.7817974362806785, 1.8877486253633868
+    };
+
+    std::array<float, kNoteCount> table{};
+    for (int midi = 0; midi < kNoteCount; ++midi) {
+        const int offset = midi - kA4;
+        const int octave = offset >= 0 ? offset / 12 : -((11 - offset) / 12);
+        double freq = referenceHz * kSemitoneRatio[offset - octave * 12];
+        for (int i = 0; i < octave; ++i) freq *= 2.0;
+        for (int i = 0; i > octave; --i) freq *= 0.5;
+        table[midi] = static_cast<float>(freq);
+    }
+    return table;
+}
+
+template <int ReferenceHz>
+struct Tuning
+{
+    static constexpr std::array<float, kNoteCount> kFrequencies = build(ReferenceHz);
+};
+
+static_assert(Tuning<440>::kFrequencies[kA4] == 440.0f, "A4 must be the reference pitch");
+static_assert(Tuning<440>::kFrequencies[kA4 + 12] == 880.0f, "octaves must be exact");
+
+constexpr bool isSupported(int referenceHz)
+{
+    for (int hz : kSupportedReferences) {
+        if (hz == referenceHz) return true;
+    }
+    return false;
+}
+
+// The table for `referenceHz`, or the A=440 one if that pitch isn't supported.
+inline const float *frequencies(int referenceHz)
+{
+    switch (referenceHz) {
+    case 432: return Tuning<432>::kFrequencies.data();
+    case 442: return Tuning<442>::kFrequencies.data();
+    default: return Tuning<440>::kFrequencies.data();
+    }
+}
+
+}
+
+#endif // NOTETABLE_H
@@ -0,0 +1,188 @@
+#include "NotesCache.h"
+#include "SynthGenerator.h"
+#include "Config.h"
+#include "Trace.h"
+#include <QtConcurrent>
+#include <QCryptographicHash>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDebug>
+
+NotesCache::NotesCache(QObject *parent)
+    : QObject(parent)
+    , m_diskCacheEnabled(false)
+{
+    initSlot(m_configured, true);
+    initSlot(m_other, false);
+}
+
+void NotesCache::initSlot(Slot &slot, bool diskCached)
+{
+    slot.request.speed = 0.0f;
+    slot.request.volume = 0.0f;
+    slot.request.referenceHz = 0;
+    slot.watcher = new QFutureWatcher<QByteArray>(this);
+    slot.diskCached = diskCached;
+    connect(slot.watcher, &QFutureWatcher<QByteArray>::finished, this, [this, &slot]() { onRenderFinished(slot); });
+}
+
+void NotesCache::prepare(const QString &notes, float speed, float volume, int referenceHz, const QAudioFormat &format)
+{
+    QString key = cacheKey(notes, speed, volume, referenceHz, format);
+    if (key == m_configured.request.key && (!m_configured.pcm.isEmpty() || m_configured.pendingKey == key)) {
+        return;
+    }
+    if (key == m_configured.failedKey) return;
+
+    assign(m_configured, Request{notes, speed, volume, referenceHz, format, key});
+
+    if (m_diskCacheEnabled && !isRandom(notes)) {
+        QFile file(diskCachePath(key));
+        if (file.open(QIODevice::ReadOnly)) {
+            m_configured.pcm = file.readAll();
+            if (!m_configured.pcm.isEmpty()) return;
+        }
+    }
+
+    startRender(m_configured);
+}
+
+void NotesCache::ensure(const QString &notes, float speed, float volume, int referenceHz, const QAudioFormat &format)
+{
+    QString key = cacheKey(notes, speed, volume, referenceHz, format);
+    if (key == m_configured.request.key) return;
+    if (key == m_other.request.key && (!m_other.pcm.isEmpty() || m_other.pendingKey == key)) return;
+    if (key == m_other.failedKey) return;
+
+    assign(m_other, Request{notes, speed, volume, referenceHz, format, key});
+    startRender(m_other);
+}
+
+const NotesCache::Slot *NotesCache::slotFor(const QString &key) const
+{
+    if (key == m_configured.request.key) return &m_configured;
+    if (key == m_other.request.key) return &m_other;
+    return nullptr;
+}
+
+bool NotesCache::isPending(const QString &notes, float speed, float volume, int referenceHz, const QAudioFormat &format) const
+{
+    QString key = cacheKey(notes, speed, volume, referenceHz, format);
+    const Slot *slot = slotFor(key);
+    return slot && slot->pendingKey == key;
+}
+
+QByteArray NotesCache::takePcm(const QString &notes, float speed, float volume, int referenceHz, const QAudioFormat &format)
+{
+    QString key = cacheKey(notes, speed, volume, referenceHz, format);
+    Slot *slot = const_cast<Slot *>(slotFor(key));
+    if (!slot || slot->pcm.isEmpty()) {
+        // Rendering here would stall the GUI thread at the top of the hour.
+        qWarning() << "Notes not rendered yet, skipping chime:" << notes;
+        return QByteArray();
+    }
+
+    QByteArray pcm = slot->pcm;
+    if (isRandom(notes)) {
+        slot->pcm.clear();
+        startRender(*slot);
+    }
+    return pcm;
+}
+
+QByteArray NotesCache::render(const QString &notes, float speed, float volume, int referenceHz,
+                              const QAudioFormat &format)
+{
+    TRACE_SCOPE("NotesCache::render");
+    SynthGenerator generator(format);
+    generator.setSequence(notes, speed, volume, referenceHz);
+    generator.start();
+
+    QByteArray pcm(generator.totalBytes(), Qt::Uninitialized);
+    qint64 done = 0;
+    while (done < pcm.size()) {
+        qint64 n = generator.read(pcm.data() + done, pcm.size() - done);
+        if (n <= 0) break;
+        done += n;
+    }
+    pcm.truncate(done);
+    return pcm;
+}
+
+bool NotesCache::isRandom(const QString &notes)
+{
+    for (NoteTokenizer tokens(notes); tokens.next(); ) {
+        if (tokens.token() == QLatin1String("?")) return true;
+    }
+    return false;
+}
+
+void NotesCache::onRenderFinished(Slot &slot)
+{
+    if (slot.pendingKey.isEmpty()) return;
+
+    bool current = (slot.pendingKey == slot.request.key);
+    slot.pendingKey.clear();
+    if (!current) return;
+
+    slot.pcm = slot.watcher->result();
+    if (slot.pcm.isEmpty()) {
+        // Rendering the same request again would come back empty too.
+        qWarning() << "Notes rendered to nothing, not retrying:" << slot.request.notes;
+        slot.failedKey = slot.request.key;
+    } else if (slot.diskCached && m_diskCacheEnabled && !isRandom(slot.request.notes)
+               && Config::makeCacheDir()) {
+        QFile file(diskCachePath(slot.request.key));
+        if (file.open(QIODevice::WriteOnly)) {
+            file.write(slot.pcm);
+        }
+        pruneDiskCache(slot.request.key);
+    }
+    emit pcmReady();
+}
+
+QString NotesCache::cacheKey(const QString &notes, float speed, float volume, int referenceHz,
+                             const QAudioFormat &format)
+{
+    return QString("%1|%2|%3|%4|%5|%6|%7").arg(notes,
+                                               QString::number(speed),
+                                               QString::number(volume),
+                                               QString::number(referenceHz),
+                                               QString::number(format.sampleRate()),
+                                               QString::number(format.channelCount()),
+                                               QString::number(static_cast<int>(format.sampleFormat())));
+}
+
+QString NotesCache::diskCachePath(const QString &key) const
+{
+    QByteArray hash = QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1).toHex();
+    return Config::cachePath(QString("notes-%1.pcm").arg(QString::fromLatin1(hash)));
+}
+
+void NotesCache::pruneDiskCache(const QString &key) const
+{
+    // Only the configured sequence is kept on disk, so anything else is
+    // left over from an earlier melody, speed or volume.
+    const QString keep = QFileInfo(diskCachePath(key)).fileName();
+    QDir dir = QFileInfo(diskCachePath(key)).absoluteDir();
+    for (const QString &name : dir.entryList({QStringLiteral("notes-*.pcm")}, QDir::Files)) {
+        if (name != keep) dir.remove(name);
+    }
+}
+
+void NotesCache::assign(Slot &slot, const Request &request)
+{
+    // A render still running for the old request is dropped when it lands.
+    slot.request = request;
+    slot.pcm.clear();
+}
+
+void NotesCache::startRender(Slot &slot)
+{
+    const Request &request = slot.request;
+    slot.pendingKey = request.key;
+    slot.watcher->setFuture(QtConcurrent::run(&NotesCache::render,
+                                              request.notes, request.speed, request.volume,
+                                              request.referenceHz, request.format));
+}
@@ -0,0 +1,80 @@
+#ifndef NOTESCACHE_H
+#define NOTESCACHE_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QAudioFormat>
+#include <QFutureWatcher>
+
+// Holds the fully rendered PCM for the configured Notes sequence so playback
+// at the top of the hour is just a buffer read. Rendering happens on a worker
+// thread when the config is loaded; sequences with random (`?`) notes are
+// re-rendered in the background after each play so every chime differs.
+// Nothing is ever rendered on the calling thread: a chime whose sequence is
+// still rendering waits for pcmReady().
+class NotesCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit NotesCache(QObject *parent = nullptr);
+
+    void setDiskCacheEnabled(bool enabled) { m_diskCacheEnabled = enabled; }
+
+    // Starts rendering the configured sequence in the background unless it
+    // is already cached.
+    void prepare(const QString &notes, float speed, float volume, int referenceHz, const QAudioFormat &format);
+    // Same for any other sequence (e.g. an unsaved test), which gets a slot
+    // of its own so the configured one stays cached.
+    void ensure(const QString &notes, float speed, float volume, int referenceHz, const QAudioFormat &format);
+    // True while the sequence is still being rendered.
+    bool isPending(const QString &notes, float speed, float volume, int referenceHz, const QAudioFormat &format) const;
+
+    // Returns the rendered PCM, or empty if it isn't ready (yet). Random
+    // sequences are re-rendered in the background once taken.
+    QByteArray takePcm(const QString &notes, float speed, float volume, int referenceHz, const QAudioFormat &format);
+
+    static QByteArray render(const QString &notes, float speed, float volume, int referenceHz,
+                             const QAudioFormat &format);
+    static bool isRandom(const QString &notes);
+
+signals:
+    void pcmReady();
+
+private:
+    struct Request {
+        QString notes;
+        float speed;
+        float volume;
+        int referenceHz;
+        QAudioFormat format;
+        QString key;
+    };
+
+    // One sequence's PCM and the background render producing it.
+    struct Slot {
+        Request request;
+        QByteArray pcm;
+        QString pendingKey;
+        QString failedKey; // last request whose render came back empty
+        QFutureWatcher<QByteArray> *watcher;
+        bool diskCached;
+    };
+
+    static QString cacheKey(const QString &notes, float speed, float volume, int referenceHz,
+                            const QAudioFormat &format);
+    QString diskCachePath(const QString &key) const;
+    // Deletes every rendered file on disk except the one for `key`.
+    void pruneDiskCache(const QString &key) const;
+    void initSlot(Slot &slot, bool diskCached);
+    const Slot *slotFor(const QString &key) const;
+    void assign(Slot &slot, const Request &request);
+    void startRender(Slot &slot);
+    void onRenderFinished(Slot &slot);
+
+    Slot m_configured;
+    Slot m_other;
+    bool m_diskCacheEnabled;
+};
+
+#endif // NOTESCACHE_H
@@ -0,0 +1,119 @@
+#include "OfflineRenderer.h"
+#include "SynthGenerator.h"
+#include "WavFile.h"
+#include "Config.h"
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTextStream>
+
+namespace OfflineRenderer {
+
+bool requested(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        if (qstrcmp(argv[i], "--render") == 0) return true;
+    }
+    return false;
+}
+
+int run(const QStringList &arguments)
+{
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    Config::AppConfig defaults = Config::getDefaults();
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Render a chime to a WAV file without playing it.");
+    parser.addHelpOption();
+    parser.addOptions({
+        {"render", "Write the rendered chime to <file>.", "file"},
+        {"mode", "Chime mode to render (only Notes is supported).", "mode", "Notes"},
+        {"notes", "Note sequence to render.", "notes", defaults.notes},
+        {"speed", "Note speed multiplier.", "speed", QString::number(defaults.noteSpeed)},
+        {"pitch", "Reference pitch of A4 in Hz (432, 440 or 442).", "hz", QString::number(defaults.referencePitch)},
+        {"volume", "Volume from 0.0 to 1.0.", "volume", QString::number(defaults.volume)},
+        {"rate", "Sample rate in Hz.", "rate", "44100"},
+        {"channels", "Channel count.", "channels", "2"},
+        {"format", "Sample format: int16, int32 or float.", "format", "int16"},
+    });
+    parser.process(arguments);
+
+    if (parser.value("mode") != "Notes") {
+        err << "Only Notes mode can be rendered offline." << Qt::endl;
+        return 2;
+    }
+
+    bool speedOk = false, pitchOk = false, volumeOk = false, rateOk = false, channelsOk = false;
+    float speed = parser.value("speed").toFloat(&speedOk);
+    int pitch = parser.value("pitch").toInt(&pitchOk);
+    float volume = parser.value("volume").toFloat(&volumeOk);
+    int rate = parser.value("rate").toInt(&rateOk);
+    int channels = parser.value("channels").toInt(&channelsOk);
+    if (!speedOk || speed <= 0.0f || !pitchOk || !NoteTable::isSupported(pitch)
+        || !volumeOk || volume < 0.0f || volume > 1.0f || !rateOk || rate <= 0 || !channelsOk || channels <= 0) {
+        err << "Invalid --speed, --pitch, --volume, --rate or --channels value." << Qt::endl;
+        return 2;
+    }
+
+    const QString sampleFormat = parser.value("format");
+    QAudioFormat format;
+    format.setSampleRate(rate);
+    format.setChannelCount(channels);
+    if (sampleFormat == "int16") {
+        format.setSampleFormat(QAudioFormat::Int16);
+    } else if (sampleFormat == "int32") {
+        format.setSampleFormat(QAudioFormat::Int32);
+    } else if (sampleFormat == "float") {
+        format.setSampleFormat(QAudioFormat::Float);
+    } else {
+        err << "Invalid --format value; use int16, int32 or float." << Qt::endl;
+        return 2;
+    }
+
+    SynthGenerator generator(format);
+    generator.setSequence(parser.value("notes"), speed, volume, pitch);
+    for (const NoteParseError &error : generator.parseErrors()) {
+        err << "Ignoring invalid note \"" << error.token << "\" at position " << error.position << Qt::endl;
+    }
+    generator.start();
+    const qint64 totalBytes = generator.totalBytes();
+
+    QFile file(parser.value("render"));
+    if (!file.open(QIODevice::WriteOnly)) {
+        err << "Cannot write " << file.fileName() << ": " << file.errorString() << Qt::endl;
+        return 1;
+    }
+    file.write(WavFile::header(format, static_cast<quint32>(totalBytes)));
+
+    // Only time spent inside the generator counts towards throughput.
+    QByteArray chunk(64 * 1024 - 64 * 1024 % format.bytesPerFrame(), Qt::Uninitialized);
+    qint64 renderNs = 0;
+    qint64 written = 0;
+    QElapsedTimer timer;
+    while (written < totalBytes) {
+        timer.start();
+        qint64 n = generator.read(chunk.data(), qMin<qint64>(chunk.size(), totalBytes - written));
+        renderNs += timer.nsecsElapsed();
+        if (n <= 0) break;
+        file.write(chunk.constData(), n);
+        written += n;
+    }
+    if (written != totalBytes) {
+        // The generator stopped short; make the header match what was written.
+        file.seek(0);
+        file.write(WavFile::header(format, static_cast<quint32>(written)));
+    }
+    file.close();
+
+    const qint64 frames = written / format.bytesPerFrame();
+    const double renderSec = renderNs / 1e9;
+    const double audioSec = static_cast<double>(frames) / rate;
+    out << "Rendered " << frames << " frames (" << audioSec << " s) to " << file.fileName() << Qt::endl;
+    out << "render_ns=" << renderNs
+        << " samples_per_sec=" << (renderSec > 0 ? qint64(frames / renderSec) : 0)
+        << " realtime_factor=" << (renderSec > 0 ? audioSec / renderSec : 0.0) << Qt::endl;
+    return 0;
+}
+
+}
@@ -0,0 +1,15 @@
+#ifndef OFFLINERENDERER_H
+#define OFFLINERENDERER_H
+
+#include <QStringList>
+
+// Headless `--render out.wav` mode: pulls SynthGenerator as fast as the CPU
+// allows and writes a WAV file, without a tray, display or audio device.
+namespace OfflineRenderer {
+    // Returns true if `argv` asks for an offline render.
+    bool requested(int argc, char *argv[]);
+    // Runs the render under an existing QCoreApplication; returns the exit code.
+    int run(const QStringList &arguments);
+}
+
+#endif // OFFLINERENDERER_H
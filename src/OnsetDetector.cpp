@@ -0,0 +1,232 @@
+#include "OnsetDetector.h"
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// Log compression before the difference, so a quiet partial entering counts
+// for about as much as a loud one growing.
+constexpr float kCompression = 10.0f;
+// Onsets closer than this are one hit (hammer rebound, click plus body).
+constexpr int kMinOnsetGapMs = 50;
+// A later onset this strong relative to the first means the file itself
+// repeats, and strikes shouldn't be spaced further apart than that.
+constexpr float kRepeatStrength = 0.5f;
+constexpr int kMinRepeatMs = 300;
+
+double toDb(float meanSquare)
+{
+    return 10.0 * std::log10(qMax(meanSquare, 1e-12f));
+}
+
+}
+
+OnsetDetector::OnsetDetector(int sampleRate, int channels)
+    : m_sampleRate(qMax(1, sampleRate))
+    , m_channels(qMax(1, channels))
+    , m_hop(kFrameSize / 2)
+    , m_maxFrames(qint64(m_sampleRate) * kMaxAnalyzedMs / 1000)
+    , m_framesSeen(0)
+    , m_window(kFrameSize)
+    , m_cos(kHalf + 1)
+    , m_sin(kHalf + 1)
+    , m_bitReverse(kHalf)
+    , m_input(kFrameSize, 0.0f)
+    , m_hopFill(0)
+    , m_re(kHalf)
+    , m_im(kHalf)
+    , m_previousMagnitude(kHalf + 1, 0.0f)
+{
+    const double pi = 3.14159265358979323846;
+    for (int i = 0; i < kFrameSize; ++i) {
+        m_window[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * pi * i / kFrameSize));
+    }
+    for (int i = 0; i <= kHalf; ++i) {
+        m_cos[i] = static_cast<float>(std::cos(2.0 * pi * i / kFrameSize));
+        m_sin[i] = static_cast<float>(-std::sin(2.0 * pi * i / kFrameSize));
+    }
+    int bits = 0;
+    while ((1 << bits) < kHalf) ++bits;
+    for (int i = 0; i < kHalf; ++i) {
+        int r = 0;
+        for (int b = 0; b < bits; ++b) {
+            if (i & (1 << b)) r |= 1 << (bits - 1 - b);
+        }
+        m_bitReverse[i] = r;
+    }
+
+    const int hops = static_cast<int>(m_maxFrames / m_hop) + 1;
+    m_flux.reserve(hops);
+    m_energy.reserve(hops);
+}
+
+void OnsetDetector::feed(const float *frames, qint64 frameCount)
+{
+    const qint64 n = qMin(frameCount, m_maxFrames - m_framesSeen);
+    float *hop = m_input.data() + kFrameSize - m_hop;
+    for (qint64 f = 0; f < n; ++f) {
+        const float *frame = frames + f * m_channels;
+        float mono = 0.0f;
+        for (int c = 0; c < m_channels; ++c) mono += frame[c];
+        mono /= m_channels;
+        // Far below any decoded sample; kept out so the FFT never sees denormals.
+        hop[m_hopFill] = std::fabs(mono) > 1e-10f ? mono : 0.0f;
+
+        if (++m_hopFill == m_hop) {
+            analyzeFrame();
+            std::memmove(m_input.data(), m_input.constData() + m_hop, (kFrameSize - m_hop) * sizeof(float));
+            m_hopFill = 0;
+        }
+    }
+    m_framesSeen += qMax<qint64>(0, n);
+}
+
+void OnsetDetector::fft(float *re, float *im) const
+{
+    // Iterative radix-2 of kHalf points on split real/imaginary arrays, which
+    // the compiler vectorizes far better than std::complex. The tables hold
+    // kFrameSize-point twiddles, so this size uses every other one.
+    for (int i = 0; i < kHalf; ++i) {
+        const int j = m_bitReverse[i];
+        if (i < j) {
+            std::swap(re[i], re[j]);
+            std::swap(im[i], im[j]);
+        }
+    }
+    const float *cosTable = m_cos.constData();
+    const float *sinTable = m_sin.constData();
+    for (int size = 2; size <= kHalf; size *= 2) {
+        const int half = size / 2;
+        const int stride = kFrameSize / size;
+        for (int k = 0; k < half; ++k) {
+            const float wr = cosTable[k * stride];
+            const float wi = sinTable[k * stride];
+            for (int a = k; a < kHalf; a += size) {
+                const int b = a + half;
+                const float tr = wr * re[b] - wi * im[b];
+                const float ti = wr * im[b] + wi * re[b];
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+}
+
+void OnsetDetector::analyzeFrame()
+{
+    double energy = 0.0;
+    for (int i = kFrameSize - m_hop; i < kFrameSize; ++i) {
+        energy += m_input[i] * m_input[i];
+    }
+    m_energy.append(static_cast<float>(energy / m_hop));
+
+    // The frame is real, so it is transformed as kHalf complex points (even
+    // samples real, odd imaginary) and the two halves separated afterwards.
+    float *re = m_re.data();
+    float *im = m_im.data();
+    for (int i = 0; i < kHalf; ++i) {
+        re[i] = m_input[2 * i] * m_window[2 * i];
+        im[i] = m_input[2 * i + 1] * m_window[2 * i + 1];
+    }
+    fft(re, im);
+
+    float flux = 0.0f;
+    for (int bin = 0; bin <= kHalf; ++bin) {
+        const int k = bin % kHalf;
+        const int mirror = (kHalf - bin) % kHalf;
+        const float evenRe = 0.5f * (re[k] + re[mirror]);
+        const float evenIm = 0.5f * (im[k] - im[mirror]);
+        const float oddRe = 0.5f * (im[k] + im[mirror]);
+        const float oddIm = -0.5f * (re[k] - re[mirror]);
+        const float wr = m_cos[bin];
+        const float wi = m_sin[bin];
+        const float xr = evenRe + wr * oddRe - wi * oddIm;
+        const float xi = evenIm + wr * oddIm + wi * oddRe;
+
+        const float magnitude = std::log(1.0f + kCompression * std::sqrt(xr * xr + xi * xi));
+        flux += qMax(0.0f, magnitude - m_previousMagnitude[bin]);
+        m_previousMagnitude[bin] = magnitude;
+    }
+    m_flux.append(flux);
+}
+
+qint64 OnsetDetector::strikeIntervalUs() const
+{
+    const int hops = m_flux.size();
+    if (hops < 3) return 0;
+
+    const double hopMs = 1000.0 * m_hop / m_sampleRate;
+    auto toHops = [hopMs](int ms) { return qMax(1, static_cast<int>(ms / hopMs + 0.5)); };
+
+    double peakDb = -120.0;
+    float maxFlux = 0.0f;
+    for (int h = 0; h < hops; ++h) {
+        peakDb = qMax(peakDb, toDb(m_energy[h]));
+        maxFlux = qMax(maxFlux, m_flux[h]);
+    }
+    if (peakDb < -70.0 || maxFlux <= 0.0f) return 0;
+
+    // Onsets: local flux maxima clearly above the flux around them, in frames
+    // that aren't themselves near silence.
+    const int context = toHops(100);
+    const int minGap = toHops(kMinOnsetGapMs);
+    QVector<int> onsets;
+    for (int h = 0; h < hops; ++h) {
+        const int from = qMax(0, h - context);
+        const int to = qMin(hops - 1, h + context);
+        double mean = 0.0;
+        bool isMax = true;
+        for (int i = from; i <= to; ++i) {
+            mean += m_flux[i];
+            if (qAbs(i - h) <= 2 && m_flux[i] > m_flux[h]) isMax = false;
+        }
+        mean /= to - from + 1;
+        if (!isMax || m_flux[h] <= 1.5 * mean + 0.1 * maxFlux) continue;
+
+        float loudest = 0.0f;
+        for (int i = h; i <= qMin(hops - 1, h + 2); ++i) loudest = qMax(loudest, m_energy[i]);
+        if (toDb(loudest) < peakDb - 40.0) continue;
+
+        if (!onsets.isEmpty() && h - onsets.last() < minGap) continue;
+        onsets.append(h);
+    }
+    if (onsets.isEmpty()) return 0;
+
+    // The strike's level is taken just after its attack, and it has rung out
+    // once a ~50 ms average of the envelope falls kDecayDb below that.
+    const int first = onsets.first();
+    const int attackEnd = qMin(hops - 1, first + toHops(300));
+    int peak = first;
+    for (int h = first; h <= attackEnd; ++h) {
+        if (m_energy[h] > m_energy[peak]) peak = h;
+    }
+    const double peakLevelDb = toDb(m_energy[peak]);
+
+    const int smoothing = toHops(50);
+    int decayed = hops;
+    double sum = 0.0;
+    for (int h = peak; h < hops; ++h) {
+        sum += m_energy[h];
+        if (h - peak >= smoothing) sum -= m_energy[h - smoothing];
+        const int count = qMin(h - peak + 1, smoothing);
+        if (toDb(static_cast<float>(sum / count)) < peakLevelDb - kDecayDb) {
+            decayed = h;
+            break;
+        }
+    }
+
+    for (int i = 1; i < onsets.size(); ++i) {
+        const int h = onsets[i];
+        if (h >= decayed) break;
+        if (h - first >= toHops(kMinRepeatMs) && m_flux[h] >= kRepeatStrength * m_flux[first]) {
+            decayed = h;
+            break;
+        }
+    }
+
+    // Rounded to 10 ms so the proposal reads like a hand-picked value.
+    const qint64 ms = qBound<qint64>(kMinIntervalMs, qRound64((decayed - first) * hopMs / 10.0) * 10, kMaxIntervalMs);
+    return ms * 1000;
+}
@@ -0,0 +1,57 @@
+#ifndef ONSETDETECTOR_H
+#define ONSETDETECTOR_H
+
+#include <QtGlobal>
+#include <QVector>
+
+// Finds where a strike sample hits and how long it rings, to propose the
+// spacing between strikes. The mono downmix is cut into Hann-windowed frames;
+// onsets are peaks of the spectral flux (the summed rise in log magnitude
+// from one frame to the next) and the decay comes from the frame energy
+// envelope. Only the first kMaxAnalyzedMs are looked at, which is longer
+// than any interval worth proposing, so long files cost no more than a clip.
+class OnsetDetector
+{
+public:
+    static constexpr int kFrameSize = 1024;
+    static constexpr int kMaxAnalyzedMs = 12000;
+    static constexpr int kMinIntervalMs = 500;
+    static constexpr int kMaxIntervalMs = 10000;
+    // How far below its peak a strike has died away when the next may start.
+    static constexpr double kDecayDb = 20.0;
+
+    OnsetDetector(int sampleRate, int channels);
+
+    void feed(const float *frames, qint64 frameCount);
+
+    // Proposed start-to-start strike spacing, or 0 if the sample has no
+    // clear onset (silence, or noise without an attack).
+    qint64 strikeIntervalUs() const;
+
+private:
+    static constexpr int kHalf = kFrameSize / 2;
+
+    void analyzeFrame();
+    void fft(float *re, float *im) const;
+
+    int m_sampleRate;
+    int m_channels;
+    int m_hop;
+    qint64 m_maxFrames;
+    qint64 m_framesSeen;
+
+    QVector<float> m_window;
+    QVector<float> m_cos; // kFrameSize-point twiddles, 0..kHalf
+    QVector<float> m_sin;
+    QVector<int> m_bitReverse;
+    QVector<float> m_input; // mono, one analysis frame; new samples go in the last hop
+    int m_hopFill;
+    QVector<float> m_re;
+    QVector<float> m_im;
+    QVector<float> m_previousMagnitude;
+
+    QVector<float> m_flux;   // per hop
+    QVector<float> m_energy; // per hop, mean square of the newest hop's samples
+};
+
+#endif // ONSETDETECTOR_H
@@ -0,0 +1,194 @@
+#include "Oscillator.h"
+#include <QtMath>
+#include <algorithm>
+
+WavetableOscillator::WavetableOscillator()
+    : m_phase(0)
+    , m_increment(0)
+{
+}
+
+const float *WavetableOscillator::table()
+{
+    // One extra guard entry so interpolation never needs to wrap the index.
+    static const struct Table {
+        float data[kTableSize + 1];
+        Table() {
+            for (int i = 0; i <= kTableSize; ++i) {
+                data[i] = static_cast<float>(qSin(2.0 * M_PI * i / kTableSize));
+            }
+        }
+    } sineTable;
+    return sineTable.data;
+}
+
+void WavetableOscillator::setFrequency(float frequency, int sampleRate)
+{
+    if (frequency <= 0.0f || sampleRate <= 0) {
+        m_increment = 0;
+        return;
+    }
+    double cycles = static_cast<double>(frequency) / sampleRate;
+    m_increment = static_cast<quint32>(cycles * 4294967296.0);
+}
+
+void WavetableOscillator::render(float *out, int frames, float amplitude)
+{
+    const float *t = table();
+    const float fracScale = 1.0f / static_cast<float>(1u << kFracBits);
+    const quint32 fracMask = (1u << kFracBits) - 1;
+    quint32 phase = m_phase;
+    const quint32 increment = m_increment;
+
+    for (int i = 0; i < frames; ++i) {
+        quint32 idx = phase >> kFracBits;
+        float frac = static_cast<float>(phase & fracMask) * fracScale;
+        float a = t[idx];
+        float b = t[idx + 1];
+        out[i] = (a + (b - a) * frac) * amplitude;
+        phase += increment;
+    }
+
+    m_phase = phase;
+}
+
+AdsrEnvelope::AdsrEnvelope()
+    : m_stage(Idle)
+    , m_level(0.0f)
+    , m_step(0.0f)
+    , m_stageLeft(0)
+    , m_attackFrames(1)
+    , m_decayFrames(1)
+    , m_releaseFrames(1)
+    , m_sustainLevel(1.0f)
+{
+}
+
+void AdsrEnvelope::setShape(const Shape &shape, int sampleRate)
+{
+    auto frames = [sampleRate](float ms) { return qMax(1, qRound(ms * sampleRate / 1000.0f)); };
+    m_attackFrames = frames(shape.attackMs);
+    m_decayFrames = frames(shape.decayMs);
+    m_releaseFrames = frames(shape.releaseMs);
+    m_sustainLevel = qBound(0.0f, shape.sustainLevel, 1.0f);
+}
+
+void AdsrEnvelope::noteOn()
+{
+    enter(Attack);
+}
+
+void AdsrEnvelope::noteOff()
+{
+    if (m_stage != Idle && m_stage != Release) {
+        enter(Release);
+    }
+}
+
+void AdsrEnvelope::reset()
+{
+    m_stage = Idle;
+    m_level = 0.0f;
+    m_step = 0.0f;
+    m_stageLeft = 0;
+}
+
+void AdsrEnvelope::enter(Stage stage)
+{
+    m_stage = stage;
+    switch (stage) {
+    case Attack:
+        m_stageLeft = m_attackFrames;
+        m_step = (1.0f - m_level) / m_stageLeft;
+        break;
+    case Decay:
+        m_level = 1.0f;
+        m_stageLeft = m_decayFrames;
+        m_step = (m_sustainLevel - 1.0f) / m_stageLeft;
+        break;
+    case Sustain:
+        m_level = m_sustainLevel;
+        m_stageLeft = 0;
+        m_step = 0.0f;
+        break;
+    case Release:
+        m_stageLeft = m_releaseFrames;
+        m_step = -m_level / m_stageLeft;
+        break;
+    case Idle:
+        reset();
+        break;
+    }
+}
+
+void AdsrEnvelope::apply(float *buf, int frames)
+{
+    int i = 0;
+    while (i < frames) {
+        if (m_stage == Idle) {
+            std::fill(buf + i, buf + frames, 0.0f);
+            return;
+        }
+        if (m_stage == Sustain) {
+            const float level = m_level;
+            for (; i < frames; ++i) {
+                buf[i] *= level;
+            }
+            return;
+        }
+
+        const int n = qMin(frames - i, m_stageLeft);
+        float level = m_level;
+        const float step = m_step;
+        for (int k = 0; k < n; ++k) {
+            buf[i + k] *= level;
+            level += step;
+        }
+        m_level = level;
+        m_stageLeft -= n;
+        i += n;
+
+        if (m_stageLeft == 0) {
+            enter(m_stage == Attack ? Decay : m_stage == Decay ? Sustain : Idle);
+        }
+    }
+}
+
+namespace SampleWriter {
+
+bool isSupported(QAudioFormat::SampleFormat format)
+{
+    return monoWriter(format) != nullptr;
+}
+
+MonoWriter monoWriter(QAudioFormat::SampleFormat format)
+{
+    switch (format) {
+    case QAudioFormat::Int16: return &writeMono<QAudioFormat::Int16>;
+    case QAudioFormat::Int32: return &writeMono<QAudioFormat::Int32>;
+    case QAudioFormat::Float: return &writeMono<QAudioFormat::Float>;
+    default: return nullptr;
+    }
+}
+
+InterleavedWriter interleavedWriter(QAudioFormat::SampleFormat format)
+{
+    switch (format) {
+    case QAudioFormat::Int16: return &writeInterleaved<QAudioFormat::Int16>;
+    case QAudioFormat::Int32: return &writeInterleaved<QAudioFormat::Int32>;
+    case QAudioFormat::Float: return &writeInterleaved<QAudioFormat::Float>;
+    default: return nullptr;
+    }
+}
+
+Accumulator accumulator(QAudioFormat::SampleFormat format)
+{
+    switch (format) {
+    case QAudioFormat::Int16: return &accumulate<QAudioFormat::Int16>;
+    case QAudioFormat::Int32: return &accumulate<QAudioFormat::Int32>;
+    case QAudioFormat::Float: return &accumulate<QAudioFormat::Float>;
+    default: return nullptr;
+    }
+}
+
+}
@@ -0,0 +1,162 @@
+#ifndef OSCILLATOR_H
+#define OSCILLATOR_H
+
+#include <QtGlobal>
+#include <QAudioFormat>
+
+// Sine oscillator backed by a shared, linearly interpolated wavetable.
+// Phase is a 32-bit fixed-point accumulator that wraps for free, so the
+// inner loop has no branches and no transcendental calls.
+class WavetableOscillator
+{
+public:
+    static constexpr int kTableBits = 11;
+    static constexpr int kTableSize = 1 << kTableBits;
+
+    WavetableOscillator();
+
+    void setFrequency(float frequency, int sampleRate);
+    void reset() { m_phase = 0; }
+
+    // Writes `frames` mono samples in [-amplitude, amplitude] to `out`.
+    void render(float *out, int frames, float amplitude);
+
+private:
+    static constexpr int kFracBits = 32 - kTableBits;
+
+    static const float *table();
+
+    quint32 m_phase;
+    quint32 m_increment;
+};
+
+// Linear attack/decay/sustain/release envelope, applied in place to a block.
+// Segments are walked a run at a time so the per-sample loop stays a
+// multiply-add; noteOn() on a releasing envelope ramps up from its current
+// level rather than jumping to zero.
+class AdsrEnvelope
+{
+public:
+    struct Shape {
+        float attackMs;
+        float decayMs;
+        float sustainLevel;
+        float releaseMs;
+    };
+
+    AdsrEnvelope();
+
+    void setShape(const Shape &shape, int sampleRate);
+    void noteOn();
+    void noteOff();
+    void reset();
+
+    bool isActive() const { return m_stage != Idle; }
+    bool isReleasing() const { return m_stage == Release; }
+    float level() const { return m_level; }
+
+    // Multiplies `frames` samples of `buf` by the envelope and advances it.
+    void apply(float *buf, int frames);
+
+private:
+    enum Stage { Idle, Attack, Decay, Sustain, Release };
+
+    void enter(Stage stage);
+
+    Stage m_stage;
+    float m_level;
+    float m_step;
+    int m_stageLeft;
+    int m_attackFrames;
+    int m_decayFrames;
+    int m_releaseFrames;
+    float m_sustainLevel;
+};
+
+// Float <-> PCM conversion for the sample formats the output can run in.
+// Each loop is instantiated per format, so the format is chosen once per
+// block (or once per stream, through the function pointers below) and the
+// per-sample code has no branches on it and still vectorizes.
+namespace SampleWriter {
+    template<QAudioFormat::SampleFormat Format> struct Traits;
+
+    template<> struct Traits<QAudioFormat::Int16> {
+        using Type = qint16;
+        static Type fromFloat(float v) { return static_cast<qint16>(qBound(-1.0f, v, 1.0f) * 32767.0f); }
+        static float toFloat(Type v) { return v * (1.0f / 32768.0f); }
+    };
+
+    template<> struct Traits<QAudioFormat::Int32> {
+        using Type = qint32;
+        // Through double: 2^31 - 1 is not representable as a float.
+        static Type fromFloat(float v) { return static_cast<qint32>(qBound(-1.0f, v, 1.0f) * 2147483647.0); }
+        static float toFloat(Type v) { return v * (1.0f / 2147483648.0f); }
+    };
+
+    template<> struct Traits<QAudioFormat::Float> {
+        using Type = float;
+        static Type fromFloat(float v) { return qBound(-1.0f, v, 1.0f); }
+        static float toFloat(Type v) { return v; }
+    };
+
+    // Converts a mono float block to interleaved samples, duplicating it into
+    // every channel and clipping to full scale.
+    template<QAudioFormat::SampleFormat Format>
+    void writeMono(const float *in, void *out, int frames, int channels)
+    {
+        using T = Traits<Format>;
+        typename T::Type *dst = static_cast<typename T::Type *>(out);
+        if (channels == 2) {
+            for (int i = 0; i < frames; ++i) {
+                const typename T::Type v = T::fromFloat(in[i]);
+                dst[2 * i] = v;
+                dst[2 * i + 1] = v;
+            }
+        } else if (channels == 1) {
+            for (int i = 0; i < frames; ++i) {
+                dst[i] = T::fromFloat(in[i]);
+            }
+        } else {
+            for (int i = 0; i < frames; ++i) {
+                const typename T::Type v = T::fromFloat(in[i]);
+                for (int c = 0; c < channels; ++c) {
+                    *dst++ = v;
+                }
+            }
+        }
+    }
+
+    // Converts `samples` interleaved floats, clipping to full scale.
+    template<QAudioFormat::SampleFormat Format>
+    void writeInterleaved(const float *in, void *out, int samples)
+    {
+        using T = Traits<Format>;
+        typename T::Type *dst = static_cast<typename T::Type *>(out);
+        for (int i = 0; i < samples; ++i) {
+            dst[i] = T::fromFloat(in[i]);
+        }
+    }
+
+    // Adds `samples` PCM samples, scaled by `gain`, into `out`.
+    template<QAudioFormat::SampleFormat Format>
+    void accumulate(const void *in, float *out, int samples, float gain)
+    {
+        using T = Traits<Format>;
+        const typename T::Type *src = static_cast<const typename T::Type *>(in);
+        for (int i = 0; i < samples; ++i) {
+            out[i] += T::toFloat(src[i]) * gain;
+        }
+    }
+
+    using MonoWriter = void (*)(const float *in, void *out, int frames, int channels);
+    using InterleavedWriter = void (*)(const float *in, void *out, int samples);
+    using Accumulator = void (*)(const void *in, float *out, int samples, float gain);
+
+    // Int16, Int32 and Float; anything else gets null pointers below.
+    bool isSupported(QAudioFormat::SampleFormat format);
+    MonoWriter monoWriter(QAudioFormat::SampleFormat format);
+    InterleavedWriter interleavedWriter(QAudioFormat::SampleFormat format);
+    Accumulator accumulator(QAudioFormat::SampleFormat format);
+}
+
+#endif // OSCILLATOR_H
@@ -0,0 +1,84 @@
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <QtGlobal>
+#include <QByteArray>
+#include <atomic>
+#include <cstring>
+
+// Lock-free single-producer/single-consumer byte ring. One thread may call
+// the producer functions and one other thread the consumer functions; the
+// positions only ever grow, so full and empty are never ambiguous. A
+// SampleStream's ring is filled by the decoder thread and drained by the
+// mixer. Using both ends from one thread, as AudioRenderer does, is fine too.
+class RingBuffer
+{
+public:
+    // `capacity` is rounded up to a power of two.
+    explicit RingBuffer(qint64 capacity)
+        : m_writePos(0)
+        , m_readPos(0)
+    {
+        qint64 size = 1;
+        while (size < capacity) size <<= 1;
+        m_data = QByteArray(size, '\0');
+        m_buffer = m_data.data();
+        m_mask = size - 1;
+    }
+
+    qint64 capacity() const { return m_mask + 1; }
+    // Total bytes ever written; safe to read from either side.
+    qint64 writePosition() const { return m_writePos.load(std::memory_order_acquire); }
+
+    // Producer side.
+    qint64 writeAvailable() const
+    {
+        return capacity() - (m_writePos.load(std::memory_order_relaxed) - m_readPos.load(std::memory_order_acquire));
+    }
+
+    // Reserves the largest contiguous writable span; commit() publishes it.
+    char *writeSpan(qint64 *length)
+    {
+        const qint64 pos = m_writePos.load(std::memory_order_relaxed);
+        const qint64 offset = pos & m_mask;
+        *length = qMin(writeAvailable(), capacity() - offset);
+        return m_buffer + offset;
+    }
+    void commit(qint64 length) { m_writePos.fetch_add(length, std::memory_order_release); }
+
+    // Consumer side.
+    qint64 readAvailable() const
+    {
+        return m_writePos.load(std::memory_order_acquire) - m_readPos.load(std::memory_order_relaxed);
+    }
+    qint64 readPosition() const { return m_readPos.load(std::memory_order_relaxed); }
+
+    qint64 read(char *out, qint64 maxlen)
+    {
+        const qint64 pos = m_readPos.load(std::memory_order_relaxed);
+        const qint64 n = qMin(maxlen, readAvailable());
+        const qint64 offset = pos & m_mask;
+        const qint64 first = qMin(n, capacity() - offset);
+        std::memcpy(out, m_buffer + offset, first);
+        std::memcpy(out + first, m_buffer, n - first);
+        m_readPos.store(pos + n, std::memory_order_release);
+        return n;
+    }
+
+    // Drops everything before `position`, or everything readable if it is past the end.
+    void skipTo(qint64 position)
+    {
+        const qint64 pos = m_readPos.load(std::memory_order_relaxed);
+        const qint64 end = m_writePos.load(std::memory_order_acquire);
+        m_readPos.store(qBound(pos, position, end), std::memory_order_release);
+    }
+
+private:
+    QByteArray m_data;
+    char *m_buffer;
+    qint64 m_mask;
+    std::atomic<qint64> m_writePos;
+    std::atomic<qint64> m_readPos;
+};
+
+#endif // RINGBUFFER_H
@@ -0,0 +1,239 @@
+#include "SampleAnalyzer.h"
+#include "Config.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <cmath>
+
+static double dbToLinear(double db)
+{
+    return std::pow(10.0, db / 20.0);
+}
+
+float SampleAnalysis::normalizationGain() const
+{
+    if (!valid || peak <= 0.0f) return 1.0f;
+
+    double gainDb = qMin(SampleAnalyzer::kTargetLufs - loudnessLufs, SampleAnalyzer::kMaxBoostDb);
+    double gain = dbToLinear(gainDb);
+    // Turning down is always allowed; turning up stops short of clipping.
+    if (gain > 1.0) gain = qMax(1.0, qMin(gain, 0.98 / peak));
+    return static_cast<float>(gain);
+}
+
+QJsonObject SampleAnalysis::toJson() const
+{
+    QJsonObject obj;
+    obj["loudness_lufs"] = loudnessLufs;
+    obj["peak"] = peak;
+    obj["leading_silence_us"] = leadingSilenceUs;
+    obj["end_us"] = endUs;
+    obj["duration_us"] = durationUs;
+    obj["strike_interval_us"] = strikeIntervalUs;
+    return obj;
+}
+
+SampleAnalysis SampleAnalysis::fromJson(const QJsonObject &obj)
+{
+    SampleAnalysis a;
+    // Entries written before a field existed are measured again.
+    a.valid = obj.contains("loudness_lufs") && obj.contains("duration_us") && obj.contains("strike_interval_us");
+    a.loudnessLufs = obj["loudness_lufs"].toDouble();
+    a.peak = static_cast<float>(obj["peak"].toDouble());
+    a.leadingSilenceUs = obj["leading_silence_us"].toInteger();
+    a.endUs = obj["end_us"].toInteger();
+    a.durationUs = obj["duration_us"].toInteger();
+    a.strikeIntervalUs = obj["strike_interval_us"].toInteger();
+    return a;
+}
+
+SampleAnalyzer::SampleAnalyzer(int sampleRate, int channels)
+    : m_sampleRate(sampleRate)
+    , m_channels(qMax(1, channels))
+    , m_onsets(sampleRate, m_channels)
+    , m_shelfState(m_channels)
+    , m_highPassState(m_channels)
+    , m_frames(0)
+    , m_firstLoud(-1)
+    , m_lastAudible(-1)
+    , m_peak(0.0f)
+    , m_subBlockFrames(qMax(1, sampleRate / 10))
+    , m_subBlockEnergy(0.0)
+    , m_subBlockFill(0)
+{
+    // BS.1770 K-weighting at any sample rate, derived from the analog
+    // prototypes (high-shelf "pre-filter", then the RLB high-pass).
+    const double pi = 3.14159265358979323846;
+    double f0 = 1681.974450955533;
+    double q = 0.7071752369554196;
+    double k = std::tan(pi * f0 / sampleRate);
+    const double vh = dbToLinear(3.999843853973347);
+    const double vb = std::pow(vh, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+    m_shelf = Biquad{(vh + vb * k / q + k * k) / a0,
+                     2.0 * (k * k - vh) / a0,
+                     (vh - vb * k / q + k * k) / a0,
+                     2.0 * (k * k - 1.0) / a0,
+                     (1.0 - k / q + k * k) / a0};
+
+    f0 = 38.13547087602444;
+    q = 0.5003270373238773;
+    k = std::tan(pi * f0 / sampleRate);
+    a0 = 1.0 + k / q + k * k;
+    m_highPass = Biquad{1.0, -2.0, 1.0,
+                        2.0 * (k * k - 1.0) / a0,
+                        (1.0 - k / q + k * k) / a0};
+}
+
+double SampleAnalyzer::run(const Biquad &f, FilterState &s, double x)
+{
+    // Transposed direct form II.
+    const double y = f.b0 * x + s.z1;
+    s.z1 = f.b1 * x - f.a1 * y + s.z2;
+    s.z2 = f.b2 * x - f.a2 * y;
+    return y;
+}
+
+void SampleAnalyzer::feed(const float *frames, qint64 frameCount)
+{
+    m_onsets.feed(frames, frameCount);
+
+    const float leadThreshold = static_cast<float>(dbToLinear(kLeadingSilenceDb));
+    const float tailThreshold = static_cast<float>(dbToLinear(kTailSilenceDb));
+
+    for (qint64 f = 0; f < frameCount; ++f) {
+        const float *frame = frames + f * m_channels;
+        float framePeak = 0.0f;
+        double energy = 0.0;
+        for (int c = 0; c < m_channels; ++c) {
+            const float x = frame[c];
+            framePeak = qMax(framePeak, std::fabs(x));
+            const double y = run(m_highPass, m_highPassState[c], run(m_shelf, m_shelfState[c], x));
+            energy += y * y;
+        }
+
+        const qint64 index = m_frames + f;
+        if (m_firstLoud < 0 && framePeak > leadThreshold) m_firstLoud = index;
+        if (framePeak > tailThreshold) m_lastAudible = index;
+        m_peak = qMax(m_peak, framePeak);
+
+        m_subBlockEnergy += energy / m_channels;
+        if (++m_subBlockFill == m_subBlockFrames) {
+            m_subBlocks.append(m_subBlockEnergy / m_subBlockFrames);
+            m_subBlockEnergy = 0.0;
+            m_subBlockFill = 0;
+        }
+    }
+    m_frames += frameCount;
+}
+
+SampleAnalysis SampleAnalyzer::result() const
+{
+    SampleAnalysis a;
+    if (m_frames == 0) return a;
+
+    auto toLufs = [](double meanSquare) { return -0.691 + 10.0 * std::log10(qMax(meanSquare, 1e-20)); };
+
+    // 400 ms blocks stepping by 100 ms. A clip shorter than one block is
+    // measured as a whole, partial last block included.
+    QVector<double> blocks;
+    for (int i = 0; i + 4 <= m_subBlocks.size(); ++i) {
+        blocks.append((m_subBlocks[i] + m_subBlocks[i + 1] + m_subBlocks[i + 2] + m_subBlocks[i + 3]) / 4.0);
+    }
+    if (blocks.isEmpty()) {
+        double sum = m_subBlockEnergy;
+        for (double e : m_subBlocks) sum += e * m_subBlockFrames;
+        blocks.append(sum / m_frames);
+    }
+
+    auto gatedMean = [&](double thresholdLufs, int *count) {
+        double sum = 0.0;
+        *count = 0;
+        for (double b : blocks) {
+            if (toLufs(b) > thresholdLufs) {
+                sum += b;
+                ++*count;
+            }
+        }
+        return *count > 0 ? sum / *count : 0.0;
+    };
+
+    int count = 0;
+    const double absoluteGated = gatedMean(-70.0, &count);
+    if (count > 0) {
+        const double relativeGated = gatedMean(toLufs(absoluteGated) - 10.0, &count);
+        a.loudnessLufs = toLufs(relativeGated);
+    } else {
+        a.loudnessLufs = -70.0; // silence
+    }
+
+    auto toUs = [this](qint64 frames) { return frames * 1000000 / m_sampleRate; };
+    a.valid = true;
+    a.peak = m_peak;
+    a.durationUs = toUs(m_frames);
+    a.leadingSilenceUs = m_firstLoud >= 0 ? toUs(m_firstLoud) : 0;
+    a.endUs = m_lastAudible >= 0 ? toUs(m_lastAudible + 1) : a.durationUs;
+    a.strikeIntervalUs = m_onsets.strikeIntervalUs();
+    return a;
+}
+
+AnalysisCache::AnalysisCache()
+    : m_loaded(false)
+{
+}
+
+QString AnalysisCache::contentKey(const QString &path)
+{
+    const bool builtin = Config::isBuiltinSound(path);
+    QFile file(builtin ? Config::builtinResourcePath(path) : path);
+    if (!file.open(QIODevice::ReadOnly)) return QString();
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(&file);
+    // Resources have no meaningful mtime; the hash alone identifies them.
+    const qint64 modified = builtin ? 0 : QFileInfo(path).lastModified().toMSecsSinceEpoch();
+    return QString("%1:%2").arg(QString::fromLatin1(hash.result().toHex())).arg(modified);
+}
+
+QString AnalysisCache::cachePath()
+{
+    return Config::cachePath("analysis.json");
+}
+
+void AnalysisCache::load()
+{
+    m_loaded = true;
+    QFile file(cachePath());
+    if (file.open(QIODevice::ReadOnly)) {
+        m_entries = QJsonDocument::fromJson(file.readAll()).object();
+    }
+}
+
+bool AnalysisCache::lookup(const QString &key, SampleAnalysis *analysis)
+{
+    if (!m_loaded) load();
+    if (key.isEmpty() || !m_entries.contains(key)) return false;
+    *analysis = SampleAnalysis::fromJson(m_entries[key].toObject());
+    return analysis->valid;
+}
+
+void AnalysisCache::store(const QString &key, const SampleAnalysis &analysis)
+{
+    if (key.isEmpty() || !analysis.valid) return;
+    if (!m_loaded) load();
+
+    // Old versions of edited files pile up otherwise; drop arbitrary ones.
+    while (m_entries.size() >= kMaxEntries) {
+        m_entries.erase(m_entries.begin());
+    }
+    m_entries[key] = analysis.toJson();
+
+    // Kept in memory only until the config directory exists.
+    if (!Config::makeCacheDir()) return;
+    QFile file(cachePath());
+    if (file.open(QIODevice::WriteOnly)) {
+        file.write(QJsonDocument(m_entries).toJson(QJsonDocument::Compact));
+    }
+}
@@ -0,0 +1,104 @@
+#ifndef SAMPLEANALYZER_H
+#define SAMPLEANALYZER_H
+
+#include <QtGlobal>
+#include <QJsonObject>
+#include <QMetaType>
+#include <QString>
+#include <QVector>
+#include "OnsetDetector.h"
+
+// What playback needs to know about a chime file: how loud it is, how far
+// it can be turned up, and where the sound actually starts and ends. Times
+// are in microseconds so the result doesn't depend on the output format.
+struct SampleAnalysis {
+    bool valid = false;
+    double loudnessLufs = 0.0; // integrated, gated, channel-averaged
+    float peak = 0.0f;         // sample peak, 1.0 = full scale
+    qint64 leadingSilenceUs = 0;
+    qint64 endUs = 0;          // just after the last sample above the tail threshold
+    qint64 durationUs = 0;
+    qint64 strikeIntervalUs = 0; // proposed by OnsetDetector; 0 if it found no strike
+
+    // Gain that brings the file to kTargetLufs, limited so it never clips
+    // and never boosts by more than kMaxBoostDb. 1.0 if not valid.
+    float normalizationGain() const;
+
+    QJsonObject toJson() const;
+    static SampleAnalysis fromJson(const QJsonObject &obj);
+};
+
+Q_DECLARE_METATYPE(SampleAnalysis)
+
+// Measures a stream of interleaved float frames block by block, so a file
+// can be analyzed while it decodes without keeping it in memory. Loudness
+// follows ITU-R BS.1770 (K-weighting, 400 ms blocks with 75% overlap,
+// absolute and relative gates), except that channel powers are averaged
+// rather than summed so an upmixed mono file measures like the original.
+class SampleAnalyzer
+{
+public:
+    static constexpr double kTargetLufs = -20.0;
+    static constexpr double kMaxBoostDb = 12.0;
+    static constexpr double kLeadingSilenceDb = -50.0;
+    static constexpr double kTailSilenceDb = -60.0;
+
+    SampleAnalyzer(int sampleRate, int channels);
+
+    void feed(const float *frames, qint64 frameCount);
+    SampleAnalysis result() const;
+
+private:
+    struct Biquad {
+        double b0, b1, b2, a1, a2;
+    };
+    struct FilterState {
+        double z1 = 0.0, z2 = 0.0;
+    };
+
+    static double run(const Biquad &f, FilterState &s, double x);
+
+    int m_sampleRate;
+    int m_channels;
+    OnsetDetector m_onsets;
+    Biquad m_shelf;
+    Biquad m_highPass;
+    QVector<FilterState> m_shelfState;
+    QVector<FilterState> m_highPassState;
+
+    qint64 m_frames;
+    qint64 m_firstLoud; // frame index, -1 until found
+    qint64 m_lastAudible;
+    float m_peak;
+
+    int m_subBlockFrames;   // 100 ms
+    double m_subBlockEnergy;
+    int m_subBlockFill;
+    QVector<double> m_subBlocks; // mean square per 100 ms
+};
+
+// Analysis results on disk, next to config.json, keyed by a file's content
+// hash and modification time so nothing is re-analyzed until the file
+// changes. Used from the decoder thread only.
+class AnalysisCache
+{
+public:
+    AnalysisCache();
+
+    // Empty if the file can't be read.
+    static QString contentKey(const QString &path);
+    static QString cachePath();
+
+    bool lookup(const QString &key, SampleAnalysis *analysis);
+    void store(const QString &key, const SampleAnalysis &analysis);
+
+private:
+    static constexpr int kMaxEntries = 256;
+
+    void load();
+
+    QJsonObject m_entries;
+    bool m_loaded;
+};
+
+#endif // SAMPLEANALYZER_H
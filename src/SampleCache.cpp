@@ -0,0 +1,628 @@
+#include "SampleCache.h"
+#include "Config.h"
+#include "Trace.h"
+#include "Oscillator.h"
+#include <QAudioDecoder>
+#include <QAudioBuffer>
+#include <QFile>
+#include <QFileInfo>
+#include <QTimer>
+#include <QUrl>
+#include <QVector>
+#include <QDebug>
+#include <cstring>
+
+// Converts a decoded buffer to the cache format. Decoders normally honour
+// setAudioFormat(), in which case this is a plain copy; otherwise samples are
+// remapped to the target channel count and linearly resampled.
+static QByteArray convertBuffer(const QAudioBuffer &buffer, const QAudioFormat &target)
+{
+    const QAudioFormat src = buffer.format();
+    if (src == target) {
+        return QByteArray(buffer.constData<char>(), buffer.byteCount());
+    }
+
+    const char *in = buffer.constData<char>();
+    const int srcChannels = src.channelCount();
+    const int dstChannels = target.channelCount();
+    const int bytesPerSample = src.bytesPerSample();
+    const qint64 srcFrames = buffer.frameCount();
+    if (srcFrames <= 0 || srcChannels <= 0) return QByteArray();
+
+    const double step = static_cast<double>(src.sampleRate()) / target.sampleRate();
+    const qint64 dstFrames = static_cast<qint64>(srcFrames / step);
+
+    // Resampled to float first, then written in the target sample format.
+    QVector<float> samples(dstFrames * dstChannels);
+    float *dst = samples.data();
+    for (qint64 f = 0; f < dstFrames; ++f) {
+        double pos = f * step;
+        qint64 i0 = static_cast<qint64>(pos);
+        qint64 i1 = qMin(i0 + 1, srcFrames - 1);
+        float frac = static_cast<float>(pos - i0);
+        for (int c = 0; c < dstChannels; ++c) {
+            int sc = c % srcChannels;
+            float a = src.normalizedSampleValue(in + (i0 * srcChannels + sc) * bytesPerSample);
+            float b = src.normalizedSampleValue(in + (i1 * srcChannels + sc) * bytesPerSample);
+            *dst++ = a + (b - a) * frac;
+        }
+    }
+
+    QByteArray out(dstFrames * target.bytesPerFrame(), Qt::Uninitialized);
+    SampleWriter::interleavedWriter(target.sampleFormat())(samples.constData(), out.data(), samples.size());
+    return out;
+}
+
+SampleDecoder::SampleDecoder(const QAudioFormat &format)
+    : QObject(nullptr)
+    , m_format(format)
+    , m_decoder(nullptr)
+    , m_source(nullptr)
+    , m_currentGeneration(0)
+    , m_keepPcm(true)
+{
+}
+
+void SampleDecoder::decode(const QString &path, quint64 generation)
+{
+    enqueue(Job{path, generation, true});
+}
+
+void SampleDecoder::analyze(const QString &path, quint64 generation)
+{
+    enqueue(Job{path, generation, false});
+}
+
+void SampleDecoder::enqueue(const Job &job)
+{
+    if (!m_decoder) {
+        // Created here so it belongs to the worker thread.
+        m_decoder = new QAudioDecoder(this);
+        connect(m_decoder, &QAudioDecoder::bufferReady, this, &SampleDecoder::onBufferReady);
+        connect(m_decoder, &QAudioDecoder::finished, this, &SampleDecoder::onFinished);
+        connect(m_decoder, QOverload<QAudioDecoder::Error>::of(&QAudioDecoder::error), this, &SampleDecoder::onError);
+    }
+
+    m_queue.append(job);
+    if (m_currentPath.isEmpty()) {
+        startNext();
+    }
+}
+
+void SampleDecoder::setFormat(const QAudioFormat &format)
+{
+    // Takes effect from the next file; the one in flight finishes as it began.
+    m_format = format;
+}
+
+void SampleDecoder::startNext()
+{
+    m_currentPath.clear();
+    m_pcm.clear();
+    m_analyzer.reset();
+    closeSource();
+    if (m_queue.isEmpty()) return;
+
+    const Job job = m_queue.takeFirst();
+    m_currentPath = job.path;
+    m_currentGeneration = job.generation;
+    m_keepPcm = job.keepPcm;
+
+    // Only files that changed since they were last seen are measured again.
+    m_currentKey = AnalysisCache::contentKey(m_currentPath);
+    m_currentAnalysis = SampleAnalysis();
+    const bool known = m_analysisCache.lookup(m_currentKey, &m_currentAnalysis);
+    if (known && !m_keepPcm) {
+        QString path = m_currentPath;
+        m_currentPath.clear();
+        emit analyzed(path, m_currentGeneration, m_currentAnalysis);
+        startNext();
+        return;
+    }
+    if (!known) {
+        m_analyzer.reset(new SampleAnalyzer(m_format.sampleRate(), m_format.channelCount()));
+    }
+
+    TRACE_SCOPE("SampleDecoder::setSource");
+    if (Config::isBuiltinSound(m_currentPath)) {
+        m_source = new QFile(Config::builtinResourcePath(m_currentPath), this);
+        if (!m_source->open(QIODevice::ReadOnly)) {
+            QString path = m_currentPath;
+            m_currentPath.clear();
+            emit failed(path, m_currentGeneration, m_source->errorString());
+            startNext();
+            return;
+        }
+        m_decoder->setSourceDevice(m_source);
+    } else {
+        m_decoder->setSource(QUrl::fromLocalFile(m_currentPath));
+    }
+    m_currentFormat = m_format;
+    m_decoder->setAudioFormat(m_currentFormat);
+    m_decoder->start();
+}
+
+void SampleDecoder::closeSource()
+{
+    if (m_source) {
+        m_decoder->setSourceDevice(nullptr);
+        delete m_source;
+        m_source = nullptr;
+    }
+}
+
+void SampleDecoder::onBufferReady()
+{
+    if (m_currentPath.isEmpty()) return;
+    TRACE_SCOPE("SampleDecoder::convertBuffer");
+    while (m_decoder->bufferAvailable()) {
+        const QByteArray chunk = convertBuffer(m_decoder->read(), m_currentFormat);
+        if (m_analyzer) feedAnalyzer(chunk);
+        if (m_keepPcm) m_pcm.append(chunk);
+    }
+}
+
+void SampleDecoder::feedAnalyzer(const QByteArray &chunk)
+{
+    // The analyzer takes float whatever the output format; accumulating into
+    // zeros at unity gain is the conversion the mixer already has.
+    const int bytesPerSample = m_currentFormat.bytesPerSample();
+    const qint64 samples = chunk.size() / bytesPerSample;
+    m_analysisScratch.fill(0.0f, samples);
+    SampleWriter::accumulator(m_currentFormat.sampleFormat())(chunk.constData(), m_analysisScratch.data(), samples, 1.0f);
+    m_analyzer->feed(m_analysisScratch.constData(), samples / m_currentFormat.channelCount());
+}
+
+void SampleDecoder::onFinished()
+{
+    if (m_currentPath.isEmpty()) return;
+    onBufferReady();
+
+    QString path = m_currentPath;
+    QByteArray pcm = m_pcm;
+    m_currentPath.clear();
+    m_decoder->stop();
+    Trace::instant("SampleDecoder::decoded", pcm.size());
+
+    if (m_analyzer) {
+        TRACE_SCOPE("SampleDecoder::storeAnalysis");
+        m_currentAnalysis = m_analyzer->result();
+        m_analysisCache.store(m_currentKey, m_currentAnalysis);
+    }
+
+    if (m_keepPcm) {
+        emit decoded(path, m_currentGeneration, pcm, m_currentFormat, m_currentAnalysis);
+    } else {
+        emit analyzed(path, m_currentGeneration, m_currentAnalysis);
+    }
+    startNext();
+}
+
+void SampleDecoder::onError()
+{
+    if (m_currentPath.isEmpty()) return;
+
+    QString path = m_currentPath;
+    m_currentPath.clear();
+    emit failed(path, m_currentGeneration, m_decoder->errorString());
+    m_decoder->stop();
+    startNext();
+}
+
+StreamDecoder::StreamDecoder(const QString &path, const QAudioFormat &format, const SampleStreamPtr &stream, int retryMs,
+                             qint64 skipBytes, qint64 endBytes)
+    : QObject(nullptr)
+    , m_path(path)
+    , m_format(format)
+    , m_stream(stream)
+    , m_decoder(nullptr)
+    , m_retryTimer(nullptr)
+    , m_retryMs(retryMs)
+    , m_pendingOffset(0)
+    , m_skipBytes(skipBytes)
+    , m_endBytes(endBytes)
+    , m_decodedBytes(0)
+    , m_reachedEnd(false)
+    , m_decodeDone(false)
+{
+}
+
+void StreamDecoder::start()
+{
+    TRACE_SCOPE("StreamDecoder::start");
+    // Created here so they belong to the stream thread.
+    m_decoder = new QAudioDecoder(this);
+    m_decoder->setAudioFormat(m_format);
+    connect(m_decoder, &QAudioDecoder::bufferReady, this, &StreamDecoder::pump);
+    connect(m_decoder, &QAudioDecoder::finished, this, &StreamDecoder::onFinished);
+    connect(m_decoder, QOverload<QAudioDecoder::Error>::of(&QAudioDecoder::error), this, &StreamDecoder::onError);
+    connect(m_decoder, &QAudioDecoder::durationChanged, this, &StreamDecoder::onDurationChanged);
+
+    m_retryTimer = new QTimer(this);
+    m_retryTimer->setSingleShot(true);
+    m_retryTimer->setInterval(m_retryMs);
+    connect(m_retryTimer, &QTimer::timeout, this, &StreamDecoder::pump);
+
+    m_decoder->setSource(QUrl::fromLocalFile(m_path));
+    m_decoder->start();
+}
+
+void StreamDecoder::pump()
+{
+    if (m_stream->isCancelled()) {
+        done();
+        return;
+    }
+
+    RingBuffer &ring = m_stream->ring();
+    for (;;) {
+        if (m_pendingOffset >= m_pending.size()) {
+            // Buffers left unread hold the decoder back, which is what bounds memory.
+            if (m_reachedEnd || !m_decoder->bufferAvailable()) break;
+            m_pending = convertBuffer(m_decoder->read(), m_format);
+            const qint64 chunkStart = m_decodedBytes;
+            m_decodedBytes += m_pending.size();
+            // Silence trimmed off either end is decoded but never written.
+            m_pendingOffset = qBound<qint64>(0, m_skipBytes - chunkStart, m_pending.size());
+            if (m_endBytes >= 0 && m_decodedBytes >= m_endBytes) {
+                m_pending.truncate(qMax(m_pendingOffset, m_endBytes - chunkStart));
+                m_reachedEnd = true;
+                m_decodeDone = true;
+            }
+            continue;
+        }
+
+        qint64 length = 0;
+        char *span = ring.writeSpan(&length);
+        if (length <= 0) {
+            // Read-ahead is full; look again once the mixer has had time to drain some.
+            m_retryTimer->start();
+            return;
+        }
+        const qint64 n = qMin(length, m_pending.size() - m_pendingOffset);
+        std::memcpy(span, m_pending.constData() + m_pendingOffset, n);
+        ring.commit(n);
+        m_pendingOffset += n;
+    }
+
+    if (m_decodeDone) {
+        m_stream->finish();
+        done();
+    }
+}
+
+void StreamDecoder::onFinished()
+{
+    m_decodeDone = true;
+    pump();
+}
+
+void StreamDecoder::onError()
+{
+    qWarning() << "Failed to stream" << m_path << ":" << m_decoder->errorString();
+    m_stream->finish();
+    done();
+}
+
+void StreamDecoder::onDurationChanged(qint64 durationMs)
+{
+    if (durationMs > 0) emit lengthKnown(m_format.framesForDuration(durationMs * 1000));
+}
+
+void StreamDecoder::done()
+{
+    m_retryTimer->stop();
+    m_decoder->stop();
+    m_pending.clear();
+    deleteLater();
+}
+
+SampleCache::SampleCache(const QAudioFormat &format, QObject *parent)
+    : QObject(parent)
+    , m_format(format)
+    , m_decoder(new SampleDecoder(format))
+    , m_streamThresholdBytes(0)
+    , m_streamBufferMs(2000)
+    , m_normalize(true)
+    , m_nextGeneration(1)
+{
+    m_decoder->moveToThread(&m_thread);
+    connect(&m_thread, &QThread::finished, m_decoder, &QObject::deleteLater);
+    connect(m_decoder, &SampleDecoder::decoded, this, &SampleCache::onDecoded);
+    connect(m_decoder, &SampleDecoder::analyzed, this, &SampleCache::onAnalyzed);
+    connect(m_decoder, &SampleDecoder::failed, this, &SampleCache::onFailed);
+    connect(&m_thread, &QThread::started, []() { Trace::registerThread(); });
+    connect(&m_streamThread, &QThread::started, []() { Trace::registerThread(); });
+    m_thread.setObjectName("SampleDecoder");
+    m_streamThread.setObjectName("SampleStream");
+}
+
+SampleCache::~SampleCache()
+{
+    cancelStreams(m_entries, {});
+    if (m_streamThread.isRunning()) {
+        m_streamThread.quit();
+        m_streamThread.wait();
+    }
+
+    if (m_thread.isRunning()) {
+        m_thread.quit();
+        m_thread.wait();
+    } else {
+        delete m_decoder;
+    }
+}
+
+void SampleCache::setFormat(const QAudioFormat &format)
+{
+    if (format == m_format) return;
+    m_format = format;
+    SampleDecoder *decoder = m_decoder;
+    QMetaObject::invokeMethod(decoder, [decoder, format]() { decoder->setFormat(format); }, Qt::QueuedConnection);
+
+    // Everything held so far is in the old format; decode it again.
+    reset();
+}
+
+void SampleCache::setStreaming(qint64 thresholdBytes, int bufferMs)
+{
+    if (thresholdBytes == m_streamThresholdBytes && bufferMs == m_streamBufferMs) return;
+    m_streamThresholdBytes = thresholdBytes;
+    m_streamBufferMs = bufferMs;
+    reset();
+}
+
+void SampleCache::setNormalize(bool enabled)
+{
+    if (enabled == m_normalize) return;
+    m_normalize = enabled;
+    reset();
+}
+
+void SampleCache::reset()
+{
+    cancelStreams(m_entries, {});
+    const QStringList paths = m_entries.keys();
+    m_entries.clear();
+    // Keeps strike files in memory across the rebuild.
+    ensure(paths, m_repeated);
+}
+
+void SampleCache::cancelStreams(const QHash<QString, Entry> &entries, const QHash<QString, Entry> &kept)
+{
+    for (auto it = entries.cbegin(); it != entries.cend(); ++it) {
+        if (it->stream && kept.value(it.key()).stream != it->stream) {
+            it->stream->cancel();
+        }
+    }
+}
+
+void SampleCache::setPaths(const QStringList &paths, const QStringList &repeated)
+{
+    m_repeated = repeated;
+    QHash<QString, Entry> entries;
+    for (const QString &path : paths) {
+        request(path, entries, true, repeated.contains(path));
+    }
+    cancelStreams(m_entries, entries);
+    m_entries = entries;
+}
+
+void SampleCache::ensure(const QStringList &paths, const QStringList &repeated)
+{
+    for (const QString &path : repeated) {
+        if (!m_repeated.contains(path)) m_repeated << path;
+    }
+    QHash<QString, Entry> entries = m_entries;
+    for (const QString &path : paths) {
+        request(path, entries, false, m_repeated.contains(path));
+    }
+    cancelStreams(m_entries, entries);
+    m_entries = entries;
+}
+
+void SampleCache::request(const QString &path, QHash<QString, Entry> &entries, bool checkModified, bool repeated)
+{
+    if (path.isEmpty()) return;
+
+    auto it = m_entries.constFind(path);
+    // A streamed file that has become a strike is decoded into memory instead.
+    if (it != m_entries.cend() && !checkModified && !(repeated && it->stream)) {
+        return;
+    }
+
+    // Resources never change, so built-in sounds skip the stat.
+    const bool builtin = Config::isBuiltinSound(path);
+    const QFileInfo info(builtin ? QString() : path);
+    QDateTime modified = builtin ? QDateTime() : info.lastModified();
+    const bool streamed = !builtin && !repeated && m_streamThresholdBytes > 0 && info.size() > m_streamThresholdBytes;
+    if (it != m_entries.cend() && it->modified == modified && bool(it->stream) == streamed) {
+        entries.insert(path, *it);
+        return;
+    }
+
+    // Results of any job still running for an older version of the file
+    // carry an older generation and are ignored.
+    startDecoder();
+    SampleDecoder *decoder = m_decoder;
+    const quint64 generation = m_nextGeneration++;
+    if (streamed) {
+        // Playable untrimmed as soon as its length is known; re-rolled
+        // trimmed once analyzed.
+        entries.insert(path, Entry{modified, QByteArray(), true, openStream(path, generation, SampleAnalysis()),
+                                   SampleAnalysis(), generation, 0});
+        QMetaObject::invokeMethod(decoder, [decoder, path, generation]() { decoder->analyze(path, generation); }, Qt::QueuedConnection);
+        return;
+    }
+
+    entries.insert(path, Entry{modified, QByteArray(), true, SampleStreamPtr(), SampleAnalysis(), generation, 0});
+    QMetaObject::invokeMethod(decoder, [decoder, path, generation]() { decoder->decode(path, generation); }, Qt::QueuedConnection);
+}
+
+void SampleCache::startDecoder()
+{
+    if (!m_thread.isRunning()) {
+        // Started on the first decode so an idle config never spawns it.
+        m_thread.start(QThread::LowPriority);
+    }
+}
+
+bool SampleCache::isPending(const QStringList &paths) const
+{
+    for (const QString &path : paths) {
+        auto it = m_entries.constFind(path);
+        if (it != m_entries.cend() && it->pending) return true;
+    }
+    return false;
+}
+
+QByteArray SampleCache::pcm(const QString &path) const
+{
+    auto it = m_entries.constFind(path);
+    return it != m_entries.cend() ? it->pcm : QByteArray();
+}
+
+bool SampleCache::isStreamed(const QString &path) const
+{
+    auto it = m_entries.constFind(path);
+    return it != m_entries.cend() && it->stream;
+}
+
+SampleStreamPtr SampleCache::takeStream(const QString &path)
+{
+    auto it = m_entries.find(path);
+    if (it == m_entries.end() || !it->stream) return SampleStreamPtr();
+
+    SampleStreamPtr stream = it->stream;
+    it->stream = openStream(path, it->generation, it->analysis);
+    return stream;
+}
+
+qint64 SampleCache::frameCount(const QString &path) const
+{
+    auto it = m_entries.constFind(path);
+    if (it == m_entries.cend()) return 0;
+    if (it->stream) {
+        qint64 begin = 0;
+        qint64 end = 0;
+        if (trimRange(it->analysis, &begin, &end)) return (end - begin) / m_format.bytesPerFrame();
+        return it->streamFrames;
+    }
+    return it->pcm.size() / m_format.bytesPerFrame();
+}
+
+qint64 SampleCache::strikeIntervalUs(const QString &path) const
+{
+    auto it = m_entries.constFind(path);
+    return it != m_entries.cend() ? it->analysis.strikeIntervalUs : 0;
+}
+
+float SampleCache::gain(const QString &path) const
+{
+    if (!m_normalize) return 1.0f;
+    auto it = m_entries.constFind(path);
+    return it != m_entries.cend() ? it->analysis.normalizationGain() : 1.0f;
+}
+
+bool SampleCache::trimRange(const SampleAnalysis &analysis, qint64 *begin, qint64 *end) const
+{
+    if (!m_normalize || !analysis.valid) return false;
+    // bytesForDuration() rounds down to whole frames.
+    *begin = m_format.bytesForDuration(analysis.leadingSilenceUs);
+    *end = m_format.bytesForDuration(analysis.endUs);
+    return *end > *begin;
+}
+
+SampleStreamPtr SampleCache::openStream(const QString &path, quint64 generation, const SampleAnalysis &analysis)
+{
+    SampleStreamPtr stream = std::make_shared<SampleStream>(m_format.bytesForDuration(qint64(m_streamBufferMs) * 1000));
+    if (!m_streamThread.isRunning()) {
+        // Not low priority like the cache decoder: it feeds live playback.
+        m_streamThread.start();
+    }
+
+    qint64 begin = 0;
+    qint64 end = -1;
+    if (!trimRange(analysis, &begin, &end)) {
+        begin = 0;
+        end = -1;
+    }
+
+    // Polls a few times per buffer length while the ring is full.
+    StreamDecoder *decoder = new StreamDecoder(path, m_format, stream, qBound(10, m_streamBufferMs / 4, 250), begin, end);
+    decoder->moveToThread(&m_streamThread);
+    connect(&m_streamThread, &QThread::finished, decoder, &QObject::deleteLater);
+    connect(decoder, &StreamDecoder::lengthKnown, this, [this, path, generation](qint64 frames) {
+        onStreamLength(path, generation, frames);
+    });
+    QMetaObject::invokeMethod(decoder, &StreamDecoder::start, Qt::QueuedConnection);
+    return stream;
+}
+
+void SampleCache::onDecoded(const QString &path, quint64 generation, const QByteArray &pcm, const QAudioFormat &format,
+                            const SampleAnalysis &analysis)
+{
+    auto it = m_entries.find(path);
+    // A decode of an older version of the entry, e.g. one started before the
+    // file changed or before setFormat(); the re-decode is already queued.
+    if (it == m_entries.end() || it->generation != generation || !it->pending || format != m_format) return;
+
+    it->pending = false;
+    if (pcm.isEmpty()) {
+        emit sampleFailed(path);
+        return;
+    }
+    it->analysis = analysis;
+
+    // Trimmed once here so every strike starts on the sound itself.
+    qint64 begin = 0;
+    qint64 end = 0;
+    if (trimRange(analysis, &begin, &end) && begin < pcm.size() && (begin > 0 || end < pcm.size())) {
+        it->pcm = pcm.mid(begin, qMin<qint64>(end, pcm.size()) - begin);
+    } else {
+        it->pcm = pcm;
+    }
+    emit sampleAnalyzed(path);
+    emit sampleReady(path);
+}
+
+void SampleCache::onAnalyzed(const QString &path, quint64 generation, const SampleAnalysis &analysis)
+{
+    auto it = m_entries.find(path);
+    if (it == m_entries.end() || it->generation != generation || !it->stream) return;
+
+    it->analysis = analysis;
+    if (m_normalize && analysis.valid) {
+        // The pre-rolled stream still starts with the silence; roll a trimmed one.
+        it->stream->cancel();
+        it->stream = openStream(path, generation, analysis);
+    }
+    if (analysis.durationUs > 0) it->streamFrames = m_format.framesForDuration(analysis.durationUs);
+    emit sampleAnalyzed(path);
+    // The decoder may never report a length; the analysis always ends the wait.
+    if (it->pending) {
+        it->pending = false;
+        emit sampleReady(path);
+    }
+}
+
+void SampleCache::onStreamLength(const QString &path, quint64 generation, qint64 frames)
+{
+    auto it = m_entries.find(path);
+    if (it == m_entries.end() || it->generation != generation || !it->stream) return;
+
+    it->streamFrames = frames;
+    if (it->pending) {
+        it->pending = false;
+        emit sampleReady(path);
+    }
+}
+
+void SampleCache::onFailed(const QString &path, quint64 generation, const QString &error)
+{
+    qWarning() << "Failed to decode" << path << ":" << error;
+    auto it = m_entries.find(path);
+    if (it == m_entries.end() || it->generation != generation) return;
+    it->pending = false;
+    emit sampleFailed(path);
+}
@@ -0,0 +1,219 @@
+#ifndef SAMPLECACHE_H
+#define SAMPLECACHE_H
+
+#include <QObject>
+#include <QAudioFormat>
+#include <QByteArray>
+#include <QDateTime>
+#include <QHash>
+#include <QStringList>
+#include <QThread>
+#include <QVector>
+#include <memory>
+#include "SampleAnalyzer.h"
+#include "SampleStream.h"
+
+class QAudioDecoder;
+class QFile;
+class QTimer;
+
+// Lives on SampleCache's worker thread and decodes one file at a time into
+// PCM in the requested output format, analyzing it on the way unless the
+// analysis cache already knows the file. "builtin:" sounds are decoded from
+// the resource data in memory. Every job carries the generation of the cache
+// entry that asked for it, and results are tagged with it, so a result for a
+// file that has since been requested again can be told apart.
+class SampleDecoder : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SampleDecoder(const QAudioFormat &format);
+
+public slots:
+    void decode(const QString &path, quint64 generation);
+    // Like decode(), but only for the analysis; the PCM is not kept.
+    void analyze(const QString &path, quint64 generation);
+    void setFormat(const QAudioFormat &format);
+
+signals:
+    void decoded(const QString &path, quint64 generation, const QByteArray &pcm, const QAudioFormat &format,
+                 const SampleAnalysis &analysis);
+    void analyzed(const QString &path, quint64 generation, const SampleAnalysis &analysis);
+    void failed(const QString &path, quint64 generation, const QString &error);
+
+private slots:
+    void onBufferReady();
+    void onFinished();
+    void onError();
+
+private:
+    struct Job {
+        QString path;
+        quint64 generation;
+        bool keepPcm;
+    };
+
+    void enqueue(const Job &job);
+    void startNext();
+    void closeSource();
+    void feedAnalyzer(const QByteArray &chunk);
+
+    QAudioFormat m_format;
+    QAudioFormat m_currentFormat; // of the file being decoded
+    QAudioDecoder *m_decoder;
+    QFile *m_source;
+    QVector<Job> m_queue;
+    QString m_currentPath;
+    quint64 m_currentGeneration;
+    bool m_keepPcm;
+    QByteArray m_pcm;
+
+    AnalysisCache m_analysisCache;
+    QString m_currentKey;
+    SampleAnalysis m_currentAnalysis;
+    std::unique_ptr<SampleAnalyzer> m_analyzer; // null when the cache had a result
+    QVector<float> m_analysisScratch;
+};
+
+// Decodes one large file into a SampleStream, on SampleCache's stream
+// thread. It only reads from the decoder while the stream's ring has room, so
+// the ring's capacity is both the read-ahead and the memory cap. Deletes
+// itself when the file ends or the stream is cancelled.
+class StreamDecoder : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Only bytes [skipBytes, endBytes) of the decoded PCM reach the stream;
+    // an endBytes of -1 means to the end of the file.
+    StreamDecoder(const QString &path, const QAudioFormat &format, const SampleStreamPtr &stream, int retryMs,
+                  qint64 skipBytes = 0, qint64 endBytes = -1);
+
+public slots:
+    void start();
+
+signals:
+    // The decoder's length for the whole file, untrimmed.
+    void lengthKnown(qint64 frames);
+
+private slots:
+    void pump();
+    void onFinished();
+    void onError();
+    void onDurationChanged(qint64 durationMs);
+
+private:
+    void done();
+
+    QString m_path;
+    QAudioFormat m_format;
+    SampleStreamPtr m_stream;
+    QAudioDecoder *m_decoder;
+    QTimer *m_retryTimer; // polls while the ring is full
+    int m_retryMs;
+    QByteArray m_pending; // converted but not yet written to the ring
+    qint64 m_pendingOffset;
+    qint64 m_skipBytes;
+    qint64 m_endBytes;
+    qint64 m_decodedBytes;
+    bool m_reachedEnd; // past endBytes; the rest of the file is never read
+    bool m_decodeDone;
+};
+
+// Decodes the configured chime files once, off the GUI thread, and keeps the
+// result in memory so strikes never reopen or re-decode a file. Files larger
+// than the streaming threshold are instead played through a SampleStream; one
+// is kept pre-rolled per file so playback still starts without waiting. A
+// streamed file stays pending until its length is known, as later parts of a
+// chime are placed after it.
+// Every file is also analyzed in the background; with normalization on, its
+// leading and trailing silence is cut here and gain() levels it.
+class SampleCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SampleCache(const QAudioFormat &format, QObject *parent = nullptr);
+    ~SampleCache();
+
+    // Decodes any path not already cached (or changed on disk) and evicts
+    // everything else. Paths also in `repeated` play several times per chime
+    // and are always kept in memory: streaming them would start a decoder for
+    // every play. They are remembered, so rebuilding the cache after a
+    // format or setting change keeps them in memory.
+    void setPaths(const QStringList &paths, const QStringList &repeated = QStringList());
+    // Like setPaths(), but keeps existing entries (and repeated paths) and
+    // never touches the filesystem for paths that are already cached.
+    void ensure(const QStringList &paths, const QStringList &repeated = QStringList());
+
+    // Output format changes re-decode every cached sample.
+    void setFormat(const QAudioFormat &format);
+    // Files over `thresholdBytes` on disk (0 for none) are streamed through a
+    // ring holding `bufferMs` of audio. Cached entries are re-evaluated.
+    void setStreaming(qint64 thresholdBytes, int bufferMs);
+    // Trims silence and reports loudness-matching gains. Toggling it
+    // re-decodes everything, as the trimmed PCM is what gets cached.
+    void setNormalize(bool enabled);
+    QAudioFormat format() const { return m_format; }
+    bool isPending(const QStringList &paths) const;
+
+    // Decoded PCM in format(), or empty if not (yet) decoded or streamed.
+    QByteArray pcm(const QString &path) const;
+
+    bool isStreamed(const QString &path) const;
+    // Hands over the pre-rolled stream for `path` and starts rolling the next.
+    SampleStreamPtr takeStream(const QString &path);
+    // Length of `path` in frames, or 0 if not known (yet).
+    qint64 frameCount(const QString &path) const;
+    // Gain that levels `path` to the others; 1.0 until it has been analyzed
+    // or with normalization off.
+    float gain(const QString &path) const;
+    // Strike spacing proposed from the file's onset and decay, or 0 if not
+    // analyzed (yet) or nothing was found.
+    qint64 strikeIntervalUs(const QString &path) const;
+
+signals:
+    void sampleReady(const QString &path);
+    void sampleFailed(const QString &path);
+    void sampleAnalyzed(const QString &path);
+
+private slots:
+    void onDecoded(const QString &path, quint64 generation, const QByteArray &pcm, const QAudioFormat &format,
+                   const SampleAnalysis &analysis);
+    void onAnalyzed(const QString &path, quint64 generation, const SampleAnalysis &analysis);
+    void onFailed(const QString &path, quint64 generation, const QString &error);
+
+private:
+    struct Entry {
+        QDateTime modified;
+        QByteArray pcm;
+        bool pending; // decoding, or streamed with its length not known yet
+        SampleStreamPtr stream; // pre-rolled, for streamed files only
+        SampleAnalysis analysis;
+        quint64 generation; // of the decode or analysis job last started for it
+        qint64 streamFrames; // untrimmed length of a streamed file, once known
+    };
+
+    void request(const QString &path, QHash<QString, Entry> &entries, bool checkModified, bool repeated);
+    void startDecoder();
+    // Byte range of the audible part of a file, if it is to be trimmed.
+    bool trimRange(const SampleAnalysis &analysis, qint64 *begin, qint64 *end) const;
+    SampleStreamPtr openStream(const QString &path, quint64 generation, const SampleAnalysis &analysis);
+    void onStreamLength(const QString &path, quint64 generation, qint64 frames);
+    void reset();
+    static void cancelStreams(const QHash<QString, Entry> &entries, const QHash<QString, Entry> &kept);
+
+    QAudioFormat m_format;
+    QThread m_thread;
+    SampleDecoder *m_decoder;
+    QThread m_streamThread;
+    qint64 m_streamThresholdBytes;
+    int m_streamBufferMs;
+    bool m_normalize;
+    QHash<QString, Entry> m_entries;
+    QStringList m_repeated; // as last given to setPaths() or ensure()
+    quint64 m_nextGeneration;
+};
+
+#endif // SAMPLECACHE_H
@@ -0,0 +1,42 @@
+#ifndef SAMPLESTREAM_H
+#define SAMPLESTREAM_H
+
+#include <QtGlobal>
+#include <atomic>
+#include <memory>
+#include "RingBuffer.h"
+
+// PCM handed from a streaming decoder to the mixer through a fixed-size ring,
+// so a long file never has to fit in memory. The decoder thread is the
+// producer and the render thread the consumer; the flags let either side
+// give up without waiting for the other.
+class SampleStream
+{
+public:
+    explicit SampleStream(qint64 capacityBytes)
+        : m_ring(capacityBytes)
+        , m_finished(false)
+        , m_cancelled(false)
+    {
+    }
+
+    RingBuffer &ring() { return m_ring; }
+
+    // Producer side. finish() is called once everything has been written,
+    // including after a decode error.
+    void finish() { m_finished.store(true, std::memory_order_release); }
+    bool isCancelled() const { return m_cancelled.load(std::memory_order_relaxed); }
+
+    // Consumer side. cancel() tells the decoder to stop.
+    void cancel() { m_cancelled.store(true, std::memory_order_relaxed); }
+    bool isFinished() const { return m_finished.load(std::memory_order_acquire); }
+
+private:
+    RingBuffer m_ring;
+    std::atomic<bool> m_finished;
+    std::atomic<bool> m_cancelled;
+};
+
+using SampleStreamPtr = std::shared_ptr<SampleStream>;
+
+#endif // SAMPLESTREAM_H
@@ -1,8 +1,10 @@
 #include "SettingsDialog.h"
+#include "NoteTable.h"
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QGridLayout>
 #include <QLabel>
+#include <QCheckBox>
 #include <QComboBox>
 #include <QLineEdit>
 #include <QSpinBox>
@@ -14,6 +16,7 @@
 
 SettingsDialog::SettingsDialog(QWidget *parent)
     : QDialog(parent)
+    , suggestedIntervalMs(0)
 {
     setWindowTitle(tr("Hourly Chime Settings"));
     resize(400, 500);
@@ -34,7 +37,7 @@ SettingsDialog::SettingsDialog(QWidget *parent)
     QFormLayout *notesLayout = new QFormLayout(notesGroup);
     notesEdit = new QLineEdit(this);
     notesEdit->setToolTip(tr("Enter a sequence of notes separated by spaces (e.g., 'C E G C5').\n"
-                             "Supports sharps (#) and flats (b).\n"
+                             "Supports sharps (#) and flats (b), and chords joined with + (e.g., 'C+E+G').\n"
                              "Special notes: Z/X (rest), ? (random), - (sustain)."));
 
     noteSpeedSpin = new QDoubleSpinBox(this);
@@ -42,6 +45,12 @@ SettingsDialog::SettingsDialog(QWidget *parent)
     noteSpeedSpin->setSingleStep(0.1);
     noteSpeedSpin->setToolTip(tr("Adjust the playback speed of the notes."));
 
+    tuningCombo = new QComboBox(this);
+    for (int hz : NoteTable::kSupportedReferences) {
+        tuningCombo->addItem(tr("A4 = %1 Hz").arg(hz), hz);
+    }
+    tuningCombo->setToolTip(tr("Concert pitch the notes are tuned to."));
+
     QLabel *notesLabel = new QLabel(tr("Notes:"));
     notesLabel->setToolTip(notesEdit->toolTip());
     notesLayout->addRow(notesLabel, notesEdit);
@@ -49,13 +58,18 @@ SettingsDialog::SettingsDialog(QWidget *parent)
     QLabel *speedLabel = new QLabel(tr("Speed:"));
     speedLabel->setToolTip(noteSpeedSpin->toolTip());
     notesLayout->addRow(speedLabel, noteSpeedSpin);
+
+    QLabel *tuningLabel = new QLabel(tr("Tuning:"));
+    tuningLabel->setToolTip(tuningCombo->toolTip());
+    notesLayout->addRow(tuningLabel, tuningCombo);
     mainLayout->addWidget(notesGroup);
 
     QGroupBox *fileGroup = new QGroupBox(tr("File Configuration"), this);
     QGridLayout *fileLayout = new QGridLayout(fileGroup);
     
     audioFileEdit = new QLineEdit(this);
-    audioFileEdit->setToolTip(tr("The audio file to play in 'Single File' mode."));
+    audioFileEdit->setToolTip(tr("The audio file to play in 'Single File' mode.\n"
+                                 "builtin:gc-chime.mp3 and builtin:gc-prelude.mp3 are the bundled sounds."));
     browseAudioBtn = new QPushButton(tr("Browse..."), this);
     
     QLabel *audioLabel = new QLabel(tr("Audio File:"));
@@ -65,7 +79,8 @@ SettingsDialog::SettingsDialog(QWidget *parent)
     fileLayout->addWidget(browseAudioBtn, 0, 2);
 
     strikeFileEdit = new QLineEdit(this);
-    strikeFileEdit->setToolTip(tr("The sound file for a single clock strike (used in Grandfather Clock mode)."));
+    strikeFileEdit->setToolTip(tr("The sound file for a single clock strike (used in Grandfather Clock mode).\n"
+                                  "builtin:gc-chime.mp3 is the bundled strike."));
     browseStrikeBtn = new QPushButton(tr("Browse..."), this);
     
     QLabel *strikeLabel = new QLabel(tr("Strike File:"));
@@ -75,7 +90,8 @@ SettingsDialog::SettingsDialog(QWidget *parent)
     fileLayout->addWidget(browseStrikeBtn, 1, 2);
 
     preludeFileEdit = new QLineEdit(this);
-    preludeFileEdit->setToolTip(tr("Optional sound file to play before the strikes begin (used in Grandfather Clock mode)."));
+    preludeFileEdit->setToolTip(tr("Optional sound file to play before the strikes begin (used in Grandfather Clock mode).\n"
+                                   "builtin:gc-prelude.mp3 is the bundled prelude."));
     browsePreludeBtn = new QPushButton(tr("Browse..."), this);
     
     QLabel *preludeLabel = new QLabel(tr("Prelude File:"));
@@ -95,6 +111,10 @@ SettingsDialog::SettingsDialog(QWidget *parent)
     fileLayout->addWidget(intervalLabel, 3, 0);
     fileLayout->addWidget(strikeIntervalSpin, 3, 1);
 
+    autoIntervalCheck = new QCheckBox(tr("Auto"), this);
+    autoIntervalCheck->setToolTip(tr("Space the strikes by how long the strike file rings,\nmeasured from the file itself when it is loaded."));
+    fileLayout->addWidget(autoIntervalCheck, 3, 2);
+
     mainLayout->addWidget(fileGroup);
 
     QGroupBox *generalGroup = new QGroupBox(tr("General"), this);
@@ -127,8 +147,10 @@ SettingsDialog::SettingsDialog(QWidget *parent)
     connect(cancelBtn, &QPushButton::clicked, this, &SettingsDialog::reject);
     connect(browseAudioBtn, &QPushButton::clicked, this, &SettingsDialog::browseAudioFile);
     connect(browseStrikeBtn, &QPushButton::clicked, this, &SettingsDialog::browseStrikeFile);
+    connect(strikeFileEdit, &QLineEdit::editingFinished, this, &SettingsDialog::onStrikeFileEdited);
     connect(browsePreludeBtn, &QPushButton::clicked, this, &SettingsDialog::browsePreludeFile);
     connect(modeCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &SettingsDialog::updateUiState);
+    connect(autoIntervalCheck, &QCheckBox::toggled, this, &SettingsDialog::updateUiState);
 
     Config::AppConfig cfg = Config::load();
     int index = modeCombo->findData(cfg.mode);
@@ -136,10 +158,12 @@ SettingsDialog::SettingsDialog(QWidget *parent)
 
     notesEdit->setText(cfg.notes);
     noteSpeedSpin->setValue(cfg.noteSpeed);
+    tuningCombo->setCurrentIndex(tuningCombo->findData(cfg.referencePitch));
     audioFileEdit->setText(cfg.audioFilePath);
     strikeFileEdit->setText(cfg.strikeFilePath);
+    suggestedForPath = cfg.strikeFilePath;
     preludeFileEdit->setText(cfg.preludeFilePath);
-    strikeIntervalSpin->setValue(cfg.strikeIntervalMs);
+    setStrikeInterval(cfg.strikeIntervalMs);
     volumeSpin->setValue(cfg.volume);
 
     updateUiState();
@@ -154,6 +178,7 @@ void SettingsDialog::updateUiState()
 
     notesEdit->setEnabled(isNotes);
     noteSpeedSpin->setEnabled(isNotes);
+    tuningCombo->setEnabled(isNotes);
     
     audioFileEdit->setEnabled(isFile);
     browseAudioBtn->setEnabled(isFile);
@@ -162,19 +187,59 @@ void SettingsDialog::updateUiState()
     browseStrikeBtn->setEnabled(isGrandfather);
     preludeFileEdit->setEnabled(isGrandfather);
     browsePreludeBtn->setEnabled(isGrandfather);
-    strikeIntervalSpin->setEnabled(isGrandfather);
+    strikeIntervalSpin->setEnabled(isGrandfather && !autoIntervalCheck->isChecked());
+    autoIntervalCheck->setEnabled(isGrandfather);
+}
+
+void SettingsDialog::setStrikeInterval(int ms)
+{
+    const bool isAuto = ms == Config::kStrikeIntervalAuto;
+    autoIntervalCheck->setChecked(isAuto);
+    if (isAuto) {
+        if (suggestedIntervalMs > 0) strikeIntervalSpin->setValue(suggestedIntervalMs);
+    } else {
+        strikeIntervalSpin->setValue(ms);
+    }
+}
+
+int SettingsDialog::strikeInterval() const
+{
+    return autoIntervalCheck->isChecked() ? Config::kStrikeIntervalAuto : strikeIntervalSpin->value();
+}
+
+QString SettingsDialog::strikeFilePath() const
+{
+    return strikeFileEdit->text();
+}
+
+void SettingsDialog::onStrikeFileEdited()
+{
+    const QString path = strikeFileEdit->text();
+    if (path == suggestedForPath) return;
+    // The old file's interval no longer applies.
+    suggestedForPath = path;
+    suggestedIntervalMs = 0;
+    emit strikeFileChanged(path);
+}
+
+void SettingsDialog::setSuggestedStrikeInterval(int ms)
+{
+    suggestedIntervalMs = ms;
+    // Also the starting point if "Auto" is turned off to fine-tune by hand.
+    if (autoIntervalCheck->isChecked() && ms > 0) strikeIntervalSpin->setValue(ms);
 }
 
 void SettingsDialog::saveSettings()
 {
-    Config::AppConfig cfg;
+    Config::AppConfig cfg = Config::load();
     cfg.mode = modeCombo->currentData().toString();
     cfg.notes = notesEdit->text();
     cfg.noteSpeed = noteSpeedSpin->value();
+    cfg.referencePitch = tuningCombo->currentData().toInt();
     cfg.audioFilePath = audioFileEdit->text();
     cfg.strikeFilePath = strikeFileEdit->text();
     cfg.preludeFilePath = preludeFileEdit->text();
-    cfg.strikeIntervalMs = strikeIntervalSpin->value();
+    cfg.strikeIntervalMs = strikeInterval();
     cfg.volume = volumeSpin->value();
     
     Config::save(cfg);
@@ -191,10 +256,12 @@ void SettingsDialog::resetDefaults()
 
     notesEdit->setText(cfg.notes);
     noteSpeedSpin->setValue(cfg.noteSpeed);
+    tuningCombo->setCurrentIndex(tuningCombo->findData(cfg.referencePitch));
     audioFileEdit->setText(cfg.audioFilePath);
     strikeFileEdit->setText(cfg.strikeFilePath);
+    onStrikeFileEdited();
     preludeFileEdit->setText(cfg.preludeFilePath);
-    strikeIntervalSpin->setValue(cfg.strikeIntervalMs);
+    setStrikeInterval(cfg.strikeIntervalMs);
     volumeSpin->setValue(cfg.volume);
 
     updateUiState();
@@ -209,14 +276,15 @@ void SettingsDialog::testSettings()
         return;
     }
 
-    Config::AppConfig cfg;
+    Config::AppConfig cfg = Config::load();
     cfg.mode = modeCombo->currentData().toString();
     cfg.notes = notesEdit->text();
     cfg.noteSpeed = noteSpeedSpin->value();
+    cfg.referencePitch = tuningCombo->currentData().toInt();
     cfg.audioFilePath = audioFileEdit->text();
     cfg.strikeFilePath = strikeFileEdit->text();
     cfg.preludeFilePath = preludeFileEdit->text();
-    cfg.strikeIntervalMs = strikeIntervalSpin->value();
+    cfg.strikeIntervalMs = strikeInterval();
     cfg.volume = volumeSpin->value();
 
     if (cfg.mode == "File" || cfg.mode == "GrandfatherClock") {
@@ -240,7 +308,9 @@ void SettingsDialog::browseAudioFile()
 void SettingsDialog::browseStrikeFile()
 {
     QString path = QFileDialog::getOpenFileName(this, tr("Select Strike File"), "", tr("Audio Files (*.mp3 *.wav *.ogg)"));
-    if (!path.isEmpty()) strikeFileEdit->setText(path);
+    if (path.isEmpty()) return;
+    strikeFileEdit->setText(path);
+    onStrikeFileEdited();
 }
 
 void SettingsDialog::browsePreludeFile()
@@ -4,6 +4,7 @@
 #include <QDialog>
 #include "Config.h"
 
+class QCheckBox;
 class QComboBox;
 class QLineEdit;
 class QSpinBox;
@@ -17,13 +18,20 @@ class SettingsDialog : public QDialog
 public:
     explicit SettingsDialog(QWidget *parent = nullptr);
 
+    // The strike file as currently entered, which may not be saved yet.
+    QString strikeFilePath() const;
+
 signals:
     void configChanged();
     void testRequested(const Config::AppConfig &config);
     void stopTestRequested();
+    // A different strike file was entered; its interval should be suggested.
+    void strikeFileChanged(const QString &path);
 
 public slots:
     void onTestFinished();
+    // Interval the strike file's analysis proposes, shown while "Auto" is on.
+    void setSuggestedStrikeInterval(int ms);
 
 private slots:
     void saveSettings();
@@ -31,17 +39,25 @@ private slots:
     void browseAudioFile();
     void browseStrikeFile();
     void browsePreludeFile();
+    void onStrikeFileEdited();
     void updateUiState();
     void resetDefaults();
 
 private:
+    void setStrikeInterval(int ms);
+    int strikeInterval() const;
+
     QComboBox *modeCombo;
     QLineEdit *notesEdit;
     QDoubleSpinBox *noteSpeedSpin;
+    QComboBox *tuningCombo;
     QLineEdit *audioFileEdit;
     QLineEdit *strikeFileEdit;
     QLineEdit *preludeFileEdit;
     QSpinBox *strikeIntervalSpin;
+    QCheckBox *autoIntervalCheck;
+    int suggestedIntervalMs; // 0 until the strike file has been analyzed
+    QString suggestedForPath; // strike file suggestedIntervalMs belongs to
     QDoubleSpinBox *volumeSpin;
     
     QPushButton *browseAudioBtn;
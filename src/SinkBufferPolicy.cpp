@@ -0,0 +1,51 @@
+#include "SinkBufferPolicy.h"
+#include <QDebug>
+
+SinkBufferPolicy::SinkBufferPolicy()
+    : m_fixedMs(0)
+    , m_adaptiveMs(kInitialMs)
+    , m_cleanChimes(0)
+    , m_underrunChimes(0)
+    , m_underrun(false)
+{
+}
+
+bool SinkBufferPolicy::setFixedMs(int ms)
+{
+    const int before = bufferMs();
+    m_fixedMs = ms > 0 ? qBound(kMinMs, ms, kMaxMs) : 0;
+    return bufferMs() != before;
+}
+
+qint64 SinkBufferPolicy::bufferBytes(const QAudioFormat &format) const
+{
+    return format.bytesForDuration(qint64(bufferMs()) * 1000);
+}
+
+bool SinkBufferPolicy::chimeFinished()
+{
+    const bool underrun = m_underrun;
+    m_underrun = false;
+
+    if (underrun) {
+        m_underrunChimes++;
+        m_cleanChimes = 0;
+    } else {
+        m_cleanChimes++;
+    }
+    if (!isAdaptive()) return false;
+
+    const int before = m_adaptiveMs;
+    if (underrun) {
+        m_adaptiveMs = qMin(kMaxMs, m_adaptiveMs * 2);
+    } else if (m_cleanChimes >= kCleanChimesToShrink) {
+        m_adaptiveMs = qMax(kMinMs, m_adaptiveMs * 3 / 4);
+        m_cleanChimes = 0;
+    }
+
+    if (m_adaptiveMs != before) {
+        qInfo() << "Sink buffer" << (underrun ? "grown" : "shrunk") << "to" << m_adaptiveMs << "ms";
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,43 @@
+#ifndef SINKBUFFERPOLICY_H
+#define SINKBUFFERPOLICY_H
+
+#include <QAudioFormat>
+
+// Chooses the QAudioSink buffer size. Adaptive by default: it starts small
+// for low latency, doubles after a chime in which the sink underran, and
+// eases back down after a long run of clean chimes. A fixed size from the
+// config overrides it.
+class SinkBufferPolicy
+{
+public:
+    static constexpr int kMinMs = 20;
+    static constexpr int kInitialMs = 40;
+    static constexpr int kMaxMs = 500;
+    static constexpr int kCleanChimesToShrink = 24;
+
+    SinkBufferPolicy();
+
+    // 0 selects the adaptive policy. Returns true if the size changed.
+    bool setFixedMs(int ms);
+    bool isAdaptive() const { return m_fixedMs == 0; }
+
+    int bufferMs() const { return isAdaptive() ? m_adaptiveMs : m_fixedMs; }
+    qint64 bufferBytes(const QAudioFormat &format) const;
+
+    // The current chime ran short of audio at some point.
+    void noteUnderrun() { m_underrun = true; }
+    int underrunChimes() const { return m_underrunChimes; }
+
+    // Call once per chime when playback ends. Returns true if the size
+    // changed and the sink should be reopened.
+    bool chimeFinished();
+
+private:
+    int m_fixedMs;
+    int m_adaptiveMs;
+    int m_cleanChimes;
+    int m_underrunChimes;
+    bool m_underrun;
+};
+
+#endif // SINKBUFFERPOLICY_H
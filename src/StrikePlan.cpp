@@ -0,0 +1,29 @@
+#include "StrikePlan.h"
+#include "SampleCache.h"
+
+StrikePlan StrikePlan::make(const Config::AppConfig &config, const QDateTime &time,
+                            const QAudioFormat &format, const SampleCache &cache)
+{
+    StrikePlan plan;
+    plan.strikes = strikesForHour(time.time().hour());
+    if (!config.preludeFilePath.isEmpty()) {
+        plan.preludeFrames = cache.frameCount(config.preludeFilePath);
+    }
+
+    // An interval of -1 starts each strike exactly where the previous one
+    // ends, as does "auto" if the strike file gave nothing to go on.
+    plan.intervalFrames = cache.frameCount(config.strikeFilePath);
+    if (config.strikeIntervalMs >= 0) {
+        plan.intervalFrames = format.framesForDuration(qint64(config.strikeIntervalMs) * 1000);
+    } else if (config.strikeIntervalMs == Config::kStrikeIntervalAuto) {
+        const qint64 proposedUs = cache.strikeIntervalUs(config.strikeFilePath);
+        if (proposedUs > 0) plan.intervalFrames = format.framesForDuration(proposedUs);
+    }
+    return plan;
+}
+
+int StrikePlan::strikesForHour(int hour)
+{
+    hour %= 12;
+    return hour == 0 ? 12 : hour;
+}
@@ -0,0 +1,28 @@
+#ifndef STRIKEPLAN_H
+#define STRIKEPLAN_H
+
+#include <QAudioFormat>
+#include <QDateTime>
+#include "Config.h"
+
+class SampleCache;
+
+// When each part of a Grandfather Clock chime starts, in frames from the
+// start of the chime.
+struct StrikePlan {
+    int strikes = 0;           // 1 to 12, for the hour of the chime
+    qint64 preludeFrames = 0;  // strikes follow the prelude, if it plays
+    qint64 intervalFrames = 0; // start to start
+
+    static StrikePlan make(const Config::AppConfig &config, const QDateTime &time,
+                           const QAudioFormat &format, const SampleCache &cache);
+    // 12-hour clock: midnight and noon are both 12.
+    static int strikesForHour(int hour);
+
+    qint64 strikeOffset(int strike, bool preludePlayed) const
+    {
+        return (preludePlayed ? preludeFrames : 0) + strike * intervalFrames;
+    }
+};
+
+#endif // STRIKEPLAN_H
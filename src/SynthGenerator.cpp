@@ -1,16 +1,29 @@
 #include "SynthGenerator.h"
 #include <QtMath>
-#include <QRegularExpression>
+#include <QDebug>
+#include <algorithm>
 
 SynthGenerator::SynthGenerator(const QAudioFormat &format, QObject *parent)
     : QIODevice(parent)
     , m_format(format)
+    , m_write(SampleWriter::monoWriter(format.sampleFormat()))
     , m_currentInstructionIndex(0)
     , m_samplesGeneratedInCurrentInstruction(0)
-    , m_phase(0.0f)
+    , m_totalFrames(0)
+    , m_framesRendered(0)
+    , m_voiceAge(0)
     , m_volume(1.0f)
+    , m_referenceHz(NoteTable::kDefaultReference)
     , m_finished(true)
 {
+    if (!m_write) {
+        qWarning() << "SynthGenerator: unsupported sample format" << format.sampleFormat();
+    }
+    for (Voice &v : m_voices) {
+        v.envelope.setShape(kEnvelope, m_format.sampleRate());
+        v.gain = 0.0f;
+        v.age = 0;
+    }
 }
 
 void SynthGenerator::start()
@@ -18,64 +31,55 @@ void SynthGenerator::start()
     open(QIODevice::ReadOnly);
     m_currentInstructionIndex = 0;
     m_samplesGeneratedInCurrentInstruction = 0;
-    m_phase = 0.0f;
+    m_framesRendered = 0;
+    for (Voice &v : m_voices) {
+        v.envelope.reset();
+    }
     m_finished = false;
 }
 
-void SynthGenerator::setSequence(const QString &notes, float speed, float volume)
+void SynthGenerator::setSequence(const QString &notes, float speed, float volume, int referenceHz)
 {
     m_volume = volume;
+    m_referenceHz = referenceHz;
     parseNotes(notes, speed);
 }
 
+qint64 SynthGenerator::totalBytes() const
+{
+    return m_totalFrames * m_format.bytesPerFrame();
+}
+
 qint64 SynthGenerator::readData(char *data, qint64 maxlen)
 {
-    if (m_finished) return 0;
+    if (m_finished || !m_write) return 0;
 
-    qint64 totalBytesWritten = 0;
-    char *ptr = data;
-    qint64 bytesRemaining = maxlen;
-
-    while (bytesRemaining > 0 && m_currentInstructionIndex < m_instructions.size()) {
-        NoteInstruction &instr = m_instructions[m_currentInstructionIndex];
-        
-        qint64 samplesRemainingInInstr = instr.durationSamples - m_samplesGeneratedInCurrentInstruction;
-        qint64 bytesNeededForInstr = samplesRemainingInInstr * m_format.bytesPerFrame();
-        
-        qint64 bytesToWrite = qMin(bytesRemaining, bytesNeededForInstr);
-        qint64 samplesToWrite = bytesToWrite / m_format.bytesPerFrame();
-
-        float amplitude = 0.2f * m_volume;
-        if (instr.frequency <= 0.0f) amplitude = 0.0f;
-
-        // Assuming 16-bit signed integer format (Little Endian)
-        qint16 *samplePtr = reinterpret_cast<qint16*>(ptr);
-        
-        if (instr.frequency > 0.0f) {
-            float phaseStep = (instr.frequency * 2.0f * M_PI) / m_format.sampleRate();
-            
-            for (int i = 0; i < samplesToWrite; ++i) {
-                float sampleVal = qSin(m_phase) * amplitude;
-                qint16 pcmVal = static_cast<qint16>(sampleVal * 32767.0f);
-                *samplePtr++ = pcmVal;
-                if (m_format.channelCount() > 1) *samplePtr++ = pcmVal;
-                
-                m_phase += phaseStep;
-                if (m_phase > 2.0f * M_PI) m_phase -= 2.0f * M_PI;
-            }
-        } else {
-            memset(ptr, 0, bytesToWrite);
+    const int channels = m_format.channelCount();
+    const int bytesPerFrame = m_format.bytesPerFrame();
+    const qint64 framesWanted = maxlen / bytesPerFrame;
+    char *out = data;
+    qint64 done = 0;
+
+    while (done < framesWanted && m_currentInstructionIndex < m_instructions.size()) {
+        const NoteInstruction &instr = m_instructions.at(m_currentInstructionIndex);
+        if (m_samplesGeneratedInCurrentInstruction == 0) {
+            startInstruction(instr);
         }
 
-        ptr += bytesToWrite;
-        totalBytesWritten += bytesToWrite;
-        bytesRemaining -= bytesToWrite;
-        m_samplesGeneratedInCurrentInstruction += samplesToWrite;
+        // Blocks never straddle an instruction, so notes start on their exact frame.
+        const qint64 instrLeft = instr.durationSamples - m_samplesGeneratedInCurrentInstruction;
+        const int block = static_cast<int>(qMin(qMin<qint64>(framesWanted - done, kBlockFrames), instrLeft));
+        if (block > 0) {
+            renderVoices(block);
+            m_write(m_block, out, block, channels);
+            out += block * bytesPerFrame;
+            done += block;
+            m_samplesGeneratedInCurrentInstruction += block;
+        }
 
         if (m_samplesGeneratedInCurrentInstruction >= instr.durationSamples) {
             m_currentInstructionIndex++;
             m_samplesGeneratedInCurrentInstruction = 0;
-            m_phase = 0.0f;
         }
     }
 
@@ -83,7 +87,59 @@ qint64 SynthGenerator::readData(char *data, qint64 maxlen)
         m_finished = true;
     }
 
-    return totalBytesWritten;
+    m_framesRendered += done;
+    return done * bytesPerFrame;
+}
+
+void SynthGenerator::startInstruction(const NoteInstruction &instr)
+{
+    // The previous step fades out under this one instead of being cut.
+    for (Voice &v : m_voices) {
+        v.envelope.noteOff();
+    }
+
+    // Scale chords so stacking notes doesn't simply clip.
+    const float gain = 0.2f * m_volume / qSqrt(qMax(1, instr.noteCount));
+    for (int i = 0; i < instr.noteCount; ++i) {
+        Voice &v = allocateVoice();
+        v.oscillator.reset();
+        v.oscillator.setFrequency(m_frequencies.at(instr.firstNote + i), m_format.sampleRate());
+        v.envelope.noteOn();
+        v.gain = gain;
+        v.age = ++m_voiceAge;
+    }
+}
+
+SynthGenerator::Voice &SynthGenerator::allocateVoice()
+{
+    // Prefer a free voice, then the quietest release tail, then the oldest note.
+    Voice *best = nullptr;
+    for (Voice &v : m_voices) {
+        if (!v.envelope.isActive()) return v;
+        if (!best) {
+            best = &v;
+        } else if (v.envelope.isReleasing() != best->envelope.isReleasing()) {
+            if (v.envelope.isReleasing()) best = &v;
+        } else if (v.envelope.isReleasing() ? v.envelope.level() < best->envelope.level()
+                                            : v.age < best->age) {
+            best = &v;
+        }
+    }
+    return *best;
+}
+
+void SynthGenerator::renderVoices(int frames)
+{
+    std::fill(m_block, m_block + frames, 0.0f);
+
+    for (Voice &v : m_voices) {
+        if (!v.envelope.isActive()) continue;
+        v.oscillator.render(m_voiceBlock, frames, v.gain);
+        v.envelope.apply(m_voiceBlock, frames);
+        for (int i = 0; i < frames; ++i) {
+            m_block[i] += m_voiceBlock[i];
+        }
+    }
 }
 
 qint64 SynthGenerator::writeData(const char *data, qint64 len)
@@ -96,103 +152,146 @@ qint64 SynthGenerator::writeData(const char *data, qint64 len)
 qint64 SynthGenerator::bytesAvailable() const
 {
     if (m_finished) return 0;
-    // Return a large number to ensure QAudioSink keeps reading until we return 0 in readData
-    return m_instructions.size() > 0 ? 1024 * 1024 : 0; 
+    return (m_totalFrames - m_framesRendered) * m_format.bytesPerFrame() + QIODevice::bytesAvailable();
 }
 
+// Linear in the length of the sequence: one pass counts tokens and chord
+// separators so the instruction and frequency lists are reserved once, a
+// second classifies each token in time proportional to its length. Nothing
+// is allocated per token.
 void SynthGenerator::parseNotes(const QString &notesStr, float speed)
 {
     m_instructions.clear();
-    
-    QStringList tokens = notesStr.split(QRegularExpression("\\s+"), Qt::SkipEmptyParts);
-    
-    float currentFreq = 0.0f;
-    int currentDurationUnits = 0;
+    m_frequencies.clear();
+    m_errors.clear();
+
+    qsizetype tokenCount = 0;
+    for (NoteTokenizer counter(notesStr); counter.next(); ) {
+        ++tokenCount;
+    }
+    m_instructions.reserve(tokenCount + 1);
+    m_frequencies.reserve(tokenCount + notesStr.count(u'+'));
+
     float baseDurationMs = 300.0f / speed;
     qint64 baseDurationSamples = static_cast<qint64>((baseDurationMs / 1000.0f) * m_format.sampleRate());
 
-    for (const QString &token : tokens) {
-        if (token == "-") {
+    NoteInstruction current{0, 0, 0};
+    int currentDurationUnits = 0;
+    auto flush = [&]() {
+        if (currentDurationUnits > 0) {
+            current.durationSamples = baseDurationSamples * currentDurationUnits;
+            m_instructions.append(current);
+        }
+    };
+
+    for (NoteTokenizer tokens(notesStr); tokens.next(); ) {
+        const QStringView token = tokens.token();
+        if (token == QLatin1String("-")) {
             if (currentDurationUnits > 0) {
                 currentDurationUnits++;
             }
-        } else {
-            if (currentDurationUnits > 0) {
-                NoteInstruction instr;
-                instr.frequency = currentFreq;
-                instr.durationSamples = baseDurationSamples * currentDurationUnits;
-                m_instructions.append(instr);
-            }
+            continue;
+        }
 
-            if (token.compare("X", Qt::CaseInsensitive) == 0 || token.compare("Z", Qt::CaseInsensitive) == 0) {
-                currentFreq = 0.0f;
-                currentDurationUnits = 1;
-            } else if (token == "?") {
-                // Random note C3 (-21) to C6 (+15)
-                int semitoneOffset = QRandomGenerator::global()->bounded(-21, 16);
-                currentFreq = 440.0f * qPow(2.0f, semitoneOffset / 12.0f);
-                currentDurationUnits = 1;
-            } else {
-                float freq = parseNoteFreq(token);
-                if (freq > 0.0f) {
-                    currentFreq = freq;
-                    currentDurationUnits = 1;
-                } else {
-                    currentFreq = 0.0f;
-                    currentDurationUnits = 0;
-                }
-            }
+        flush();
+        current = NoteInstruction{static_cast<int>(m_frequencies.size()), 0, 0};
+
+        if (token.compare(QLatin1String("X"), Qt::CaseInsensitive) == 0
+            || token.compare(QLatin1String("Z"), Qt::CaseInsensitive) == 0) {
+            currentDurationUnits = 1;
+        } else if (parseChord(token)) {
+            current.noteCount = static_cast<int>(m_frequencies.size()) - current.firstNote;
+            currentDurationUnits = 1;
+        } else {
+            m_errors.append(NoteParseError{tokens.position(), token.toString()});
+            currentDurationUnits = 0;
         }
     }
+    flush();
 
-    if (currentDurationUnits > 0) {
-        NoteInstruction instr;
-        instr.frequency = currentFreq;
-        instr.durationSamples = baseDurationSamples * currentDurationUnits;
-        m_instructions.append(instr);
+    // Let the last notes ring out through their release.
+    if (!m_instructions.isEmpty() && m_instructions.last().noteCount > 0) {
+        const qint64 tailSamples = qCeil(kEnvelope.releaseMs * m_format.sampleRate() / 1000.0f);
+        m_instructions.append(NoteInstruction{0, 0, tailSamples});
     }
+
+    m_totalFrames = 0;
+    for (const NoteInstruction &instr : m_instructions) {
+        m_totalFrames += instr.durationSamples;
+    }
+
+    for (const NoteParseError &error : m_errors) {
+        qWarning() << "Ignoring invalid note" << error.token << "at position" << error.position;
+    }
+}
+
+// Appends the frequencies of a note or `+`-joined chord such as "C+E+G".
+// Either every note parses or nothing is appended.
+bool SynthGenerator::parseChord(QStringView token)
+{
+    const qsizetype first = m_frequencies.size();
+    const float *table = NoteTable::frequencies(m_referenceHz);
+
+    qsizetype start = 0;
+    while (start <= token.size()) {
+        qsizetype end = token.indexOf(u'+', start);
+        if (end < 0) end = token.size();
+        const QStringView part = token.sliced(start, end - start);
+
+        if (part == QLatin1String("?")) {
+            // Random note C3 (-21) to C6 (+15)
+            int semitoneOffset = QRandomGenerator::global()->bounded(-21, 16);
+            m_frequencies.append(table[NoteTable::kA4 + semitoneOffset]);
+        } else {
+            const int midi = parseMidiNote(part);
+            if (midi < 0) {
+                m_frequencies.resize(first);
+                return false;
+            }
+            m_frequencies.append(table[midi]);
+        }
+        start = end + 1;
+    }
+    return true;
 }
 
-float SynthGenerator::parseNoteFreq(const QString &note)
+int SynthGenerator::parseMidiNote(QStringView note)
 {
-    if (note.isEmpty()) return 0.0f;
-
-    QString n = note.toUpper();
-    int idx = 0;
-    QChar baseChar = n[idx++];
-    
-    int semitoneOffset = 0;
-    switch (baseChar.toLatin1()) {
-        case 'C': semitoneOffset = -9; break;
-        case 'D': semitoneOffset = -7; break;
-        case 'E': semitoneOffset = -5; break;
-        case 'F': semitoneOffset = -4; break;
-        case 'G': semitoneOffset = -2; break;
-        case 'A': semitoneOffset = 0; break;
-        case 'B': semitoneOffset = 2; break;
-        default: return 0.0f;
-    }
-
-    if (idx < n.length()) {
-        QChar next = n[idx];
-        if (next == '#') {
-            semitoneOffset++;
+    if (note.isEmpty()) return -1;
+
+    // Semitones above C for A..G; OR-ing 0x20 folds ASCII upper case to lower.
+    static constexpr int kNaturals[7] = {9, 11, 0, 2, 4, 5, 7};
+    const char16_t letter = note[0].unicode() | 0x20;
+    if (letter < u'a' || letter > u'g') return -1;
+
+    int semitone = kNaturals[letter - u'a'];
+    qsizetype idx = 1;
+    if (idx < note.size()) {
+        const char16_t next = note[idx].unicode();
+        if (next == u'#') {
+            semitone++;
             idx++;
-        } else if (next == 'B') {
-            semitoneOffset--;
+        } else if (next == u'b' || next == u'B') {
+            semitone--;
             idx++;
         }
     }
 
+    // No suffix means octave 4; one that isn't a number makes the token malformed.
     int octave = 4;
-    if (idx < n.length()) {
+    if (idx < note.size()) {
         bool ok;
-        int val = n.mid(idx).toInt(&ok);
-        if (ok) octave = val;
+        octave = note.mid(idx).toInt(&ok);
+        if (!ok) return -1;
     }
+    if (octave < -1 || octave > 9) return -1;
 
-    int octaveDiff = octave - 4;
-    int totalSemitones = semitoneOffset + (octaveDiff * 12);
+    const int midi = (octave + 1) * 12 + semitone;
+    return (midi >= 0 && midi < NoteTable::kNoteCount) ? midi : -1;
+}
 
-    return 440.0f * qPow(2.0f, totalSemitones / 12.0f);
+float SynthGenerator::parseNoteFreq(QStringView note, int referenceHz)
+{
+    const int midi = parseMidiNote(note);
+    return midi >= 0 ? NoteTable::frequencies(referenceHz)[midi] : 0.0f;
 }
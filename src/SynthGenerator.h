@@ -5,37 +5,115 @@
 #include <QAudioFormat>
 #include <QVector>
 #include <QRandomGenerator>
+#include "Oscillator.h"
+#include "NoteTable.h"
 
+// One step of a sequence: a chord of `noteCount` frequencies starting at
+// `firstNote` in the sequence's frequency list; no notes is a rest.
 struct NoteInstruction {
-    float frequency; // 0.0 for silence
+    int firstNote;
+    int noteCount;
     qint64 durationSamples;
 };
 
+// A token in a note sequence that isn't a note, rest, sustain or `?`.
+struct NoteParseError {
+    qsizetype position; // offset of the token in the sequence
+    QString token;
+};
+
+// Splits a note sequence on whitespace. Tokens are views into the original
+// string, so walking a sequence never allocates.
+class NoteTokenizer
+{
+public:
+    explicit NoteTokenizer(QStringView text) : m_text(text), m_end(0), m_start(0) {}
+
+    // Moves to the next token; false once the sequence is exhausted.
+    bool next()
+    {
+        qsizetype i = m_end;
+        while (i < m_text.size() && m_text[i].isSpace()) ++i;
+        if (i == m_text.size()) return false;
+        m_start = i;
+        while (i < m_text.size() && !m_text[i].isSpace()) ++i;
+        m_end = i;
+        return true;
+    }
+
+    QStringView token() const { return m_text.sliced(m_start, m_end - m_start); }
+    qsizetype position() const { return m_start; }
+
+private:
+    QStringView m_text;
+    qsizetype m_end;
+    qsizetype m_start;
+};
+
+// Renders a note sequence with a fixed bank of enveloped sine voices. Each
+// step releases the previous one and starts its own notes, so chords (`C+E+G`)
+// and release tails overlap without clicks. readData() never allocates.
+// Renders at any rate and channel count in Int16, Int32 or Float.
 class SynthGenerator : public QIODevice
 {
     Q_OBJECT
 
 public:
+    static constexpr int kMaxVoices = 32;
+
     explicit SynthGenerator(const QAudioFormat &format, QObject *parent = nullptr);
     
-    void setSequence(const QString &notes, float speed, float volume);
+    void setSequence(const QString &notes, float speed, float volume,
+                     int referenceHz = NoteTable::kDefaultReference);
     void start();
+    qint64 totalBytes() const;
+    // Tokens the last setSequence() call couldn't parse; they play as nothing.
+    const QVector<NoteParseError> &parseErrors() const { return m_errors; }
 
     qint64 readData(char *data, qint64 maxlen) override;
     qint64 writeData(const char *data, qint64 len) override;
     qint64 bytesAvailable() const override;
 
+    // MIDI number of a single note token such as "C#5" or "Bb", or -1 if it
+    // isn't a note in the MIDI range or has a suffix that isn't an octave
+    // number ("C4x"). The octave defaults to 4.
+    static int parseMidiNote(QStringView note);
+    // Frequency in Hz of a note token tuned to A4 = `referenceHz`, or 0 if invalid.
+    static float parseNoteFreq(QStringView note, int referenceHz = NoteTable::kDefaultReference);
+
 private:
+    static constexpr int kBlockFrames = 256;
+    static constexpr AdsrEnvelope::Shape kEnvelope = {5.0f, 60.0f, 0.8f, 80.0f};
+
+    struct Voice {
+        WavetableOscillator oscillator;
+        AdsrEnvelope envelope;
+        float gain;
+        quint32 age;
+    };
+
     void parseNotes(const QString &notes, float speed);
-    float parseNoteFreq(const QString &note);
-    void generateSine(char *data, qint64 maxlen);
+    bool parseChord(QStringView token);
+    void startInstruction(const NoteInstruction &instr);
+    Voice &allocateVoice();
+    void renderVoices(int frames);
 
     QAudioFormat m_format;
+    SampleWriter::MonoWriter m_write; // picked once for m_format's sample type
     QVector<NoteInstruction> m_instructions;
+    QVector<float> m_frequencies;
+    QVector<NoteParseError> m_errors;
     int m_currentInstructionIndex;
     qint64 m_samplesGeneratedInCurrentInstruction;
-    float m_phase;
+    qint64 m_totalFrames;
+    qint64 m_framesRendered;
+
+    Voice m_voices[kMaxVoices];
+    quint32 m_voiceAge;
+    float m_block[kBlockFrames];
+    float m_voiceBlock[kBlockFrames];
     float m_volume;
+    int m_referenceHz;
     bool m_finished;
 };
 
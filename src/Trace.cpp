@@ -0,0 +1,187 @@
+#include "Trace.h"
+#include <QCoreApplication>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QStringList>
+#include <QThread>
+#include <QDebug>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+namespace Trace {
+
+namespace detail {
+std::atomic<bool> enabled{false};
+}
+
+namespace {
+
+struct Event {
+    const char *name;
+    qint64 startNs;
+    qint64 durationNs; // -1 for an instant event
+    qint64 arg;
+    int tid;
+    std::atomic<bool> committed{false};
+};
+
+std::unique_ptr<Event[]> events;
+int capacity = 0;
+std::atomic<int> nextEvent{0};
+std::atomic<int> dropped{0};
+qint64 originNs = 0;
+QString outputPath;
+
+// Thread names are only touched once per thread, not per event.
+QMutex threadMutex;
+QStringList threadNames;
+thread_local int threadId = 0;
+
+int currentThreadId()
+{
+    if (threadId == 0) {
+        QMutexLocker lock(&threadMutex);
+        QString name = QThread::currentThread()->objectName();
+        if (name.isEmpty()) name = threadNames.isEmpty() ? QString("main") : QString("thread %1").arg(threadNames.size() + 1);
+        threadNames.append(name);
+        threadId = threadNames.size();
+    }
+    return threadId;
+}
+
+void record(const char *name, qint64 startNs, qint64 durationNs, qint64 arg)
+{
+    const int index = nextEvent.fetch_add(1, std::memory_order_relaxed);
+    if (index >= capacity) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    Event &e = events[index];
+    e.name = name;
+    e.startNs = startNs;
+    e.durationNs = durationNs;
+    e.arg = arg;
+    e.tid = currentThreadId();
+    e.committed.store(true, std::memory_order_release);
+}
+
+void flushAtExit()
+{
+    flush();
+}
+
+}
+
+void consumeArguments(int &argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--trace") != 0) continue;
+        if (i + 1 >= argc) {
+            qWarning() << "--trace needs an output file";
+            return;
+        }
+        start(QString::fromLocal8Bit(argv[i + 1]));
+        for (int j = i; j + 2 <= argc; ++j) argv[j] = argv[j + 2];
+        argc -= 2;
+        return;
+    }
+}
+
+void start(const QString &path, int eventCapacity)
+{
+    if (isEnabled()) return;
+
+    events.reset(new Event[eventCapacity]);
+    capacity = eventCapacity;
+    originNs = nowNs();
+    outputPath = path;
+    currentThreadId(); // the caller's thread is listed first, as "main"
+
+    detail::enabled.store(true, std::memory_order_release);
+    std::atexit(flushAtExit);
+}
+
+qint64 nowNs()
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void registerThread()
+{
+    if (isEnabled()) currentThreadId();
+}
+
+void complete(const char *name, qint64 startNs, qint64 endNs, qint64 arg)
+{
+    if (!isEnabled()) return;
+    record(name, startNs, endNs - startNs, arg);
+}
+
+void instant(const char *name, qint64 arg)
+{
+    if (!isEnabled()) return;
+    record(name, nowNs(), -1, arg);
+}
+
+bool flush()
+{
+    if (!isEnabled()) return false;
+
+    const qint64 pid = QCoreApplication::applicationPid();
+    QJsonArray traceEvents;
+    {
+        QMutexLocker lock(&threadMutex);
+        for (int i = 0; i < threadNames.size(); ++i) {
+            traceEvents.append(QJsonObject{
+                {"name", "thread_name"}, {"ph", "M"}, {"pid", pid}, {"tid", i + 1},
+                {"args", QJsonObject{{"name", threadNames.at(i)}}}});
+        }
+    }
+
+    const int count = qMin(nextEvent.load(std::memory_order_acquire), capacity);
+    for (int i = 0; i < count; ++i) {
+        const Event &e = events[i];
+        // Claimed but still being filled in by another thread.
+        if (!e.committed.load(std::memory_order_acquire)) continue;
+
+        QJsonObject obj{
+            {"name", QString::fromLatin1(e.name)},
+            {"cat", "chime"},
+            {"pid", pid},
+            {"tid", e.tid},
+            {"ts", (e.startNs - originNs) / 1000.0},
+        };
+        if (e.durationNs >= 0) {
+            obj["ph"] = "X";
+            obj["dur"] = e.durationNs / 1000.0;
+        } else {
+            obj["ph"] = "i";
+            obj["s"] = "t";
+        }
+        if (e.arg != kNoArg) obj["args"] = QJsonObject{{"value", e.arg}};
+        traceEvents.append(obj);
+    }
+
+    QJsonObject root;
+    root["traceEvents"] = traceEvents;
+    root["displayTimeUnit"] = "ms";
+    root["otherData"] = QJsonObject{{"version", HOURLY_CHIME_VERSION_STR},
+                                    {"dropped_events", dropped.load(std::memory_order_relaxed)}};
+
+    QFile file(outputPath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Cannot write trace to" << outputPath << ":" << file.errorString();
+        return false;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    qInfo() << "Wrote" << count << "trace events to" << outputPath;
+    return true;
+}
+
+}
@@ -0,0 +1,72 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <QString>
+#include <QtGlobal>
+#include <atomic>
+
+// Scoped timing events for the chime pipeline, written as Chrome trace-event
+// JSON that chrome://tracing or ui.perfetto.dev can open. Off unless
+// `--trace <file>` is given; then events go into a buffer allocated up front,
+// so recording one is a clock read and an atomic increment. A thread is named
+// in the trace on its first event, which takes a lock; threads that must
+// never block, like the render thread, call registerThread() as they start so
+// their events take no locks and allocate nothing. Names must be string
+// literals: only the pointer is stored.
+namespace Trace {
+    static constexpr int kDefaultCapacity = 1 << 16;
+    static constexpr qint64 kNoArg = -1;
+
+    namespace detail {
+        extern std::atomic<bool> enabled;
+    }
+
+    // Removes `--trace <file>` from argv and starts recording to that file.
+    // Call before any QCoreApplication sees the arguments.
+    void consumeArguments(int &argc, char *argv[]);
+
+    // Allocates room for `capacity` events and writes them to `path` at exit.
+    // Events past the capacity are dropped and counted.
+    void start(const QString &path, int capacity = kDefaultCapacity);
+    bool flush();
+
+    inline bool isEnabled() { return detail::enabled.load(std::memory_order_relaxed); }
+    // Names the calling thread in the trace now rather than on its first event.
+    void registerThread();
+    qint64 nowNs();
+
+    void complete(const char *name, qint64 startNs, qint64 endNs, qint64 arg = kNoArg);
+    void instant(const char *name, qint64 arg = kNoArg);
+
+    class Scope
+    {
+    public:
+        explicit Scope(const char *name, qint64 arg = kNoArg)
+            : m_name(isEnabled() ? name : nullptr)
+            , m_arg(arg)
+            , m_startNs(m_name ? nowNs() : 0)
+        {
+        }
+
+        ~Scope()
+        {
+            if (m_name) complete(m_name, m_startNs, nowNs(), m_arg);
+        }
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        const char *m_name;
+        qint64 m_arg;
+        qint64 m_startNs;
+    };
+}
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+// Records the rest of the enclosing block as one event; an optional second
+// argument is shown as "value" in the viewer.
+#define TRACE_SCOPE(...) Trace::Scope TRACE_CONCAT(traceScope_, __LINE__)(__VA_ARGS__)
+
+#endif // TRACE_H
@@ -0,0 +1,257 @@
+#include "UpdateChecker.h"
+#include "Config.h"
+#include <QDateTime>
+#include <QEventLoop>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QRandomGenerator>
+#include <QTextStream>
+#include <QTimer>
+#include <QtConcurrent>
+#include <QDebug>
+
+// QTimer intervals are ints.
+static constexpr qint64 kMaxTimerMs = 24LL * 60 * 60 * 1000;
+
+static QString stripV(QString version)
+{
+    if (version.startsWith("v")) version = version.mid(1);
+    return version;
+}
+
+UpdateChecker::UpdateChecker(QObject *parent)
+    : QObject(parent)
+    , m_stateLoaded(false)
+    , m_intervalHours(0)
+    , m_pendingStatus(0)
+    , m_timer(new QTimer(this))
+    , m_network(nullptr)
+    , m_parser(new QFutureWatcher<Release>(this))
+{
+    m_timer->setSingleShot(true);
+    connect(m_timer, &QTimer::timeout, this, &UpdateChecker::onTimeout);
+    connect(m_parser, &QFutureWatcher<Release>::finished, this, &UpdateChecker::onParsed);
+}
+
+void UpdateChecker::setIntervalHours(int hours)
+{
+    if (!m_stateLoaded) {
+        loadState();
+        if (hasUpdate()) {
+            // Known from an earlier run; no request needed to show it.
+            emit updateAvailable(m_state.latestVersion, m_state.latestUrl);
+        }
+    }
+    m_intervalHours = qMax(0, hours);
+    schedule();
+}
+
+bool UpdateChecker::hasUpdate() const
+{
+    return !m_state.latestVersion.isEmpty() && m_state.latestVersion != stripV(HOURLY_CHIME_VERSION_STR);
+}
+
+QUrl UpdateChecker::releaseUrl()
+{
+    QByteArray overrideUrl = qgetenv("HOURLY_CHIME_UPDATE_URL");
+    if (!overrideUrl.isEmpty()) return QUrl(QString::fromUtf8(overrideUrl));
+    return QUrl("https://api.github.com/repos/EddieDover/HourlyChime/releases/latest");
+}
+
+QString UpdateChecker::statePath()
+{
+    return Config::cachePath("update.json");
+}
+
+qint64 UpdateChecker::dueMs() const
+{
+    if (m_state.failures > 0 || m_state.lastSuccessMs == 0) return m_state.nextCheckMs;
+    // Derived from the last success so an interval change applies at once.
+    return m_state.lastSuccessMs + m_intervalHours * 3600LL * 1000 + m_state.jitterMs;
+}
+
+void UpdateChecker::schedule()
+{
+    m_timer->stop();
+    if (m_intervalHours <= 0) return;
+
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    const qint64 delay = qBound<qint64>(kStartupDelayMs, dueMs() - now, kMaxTimerMs);
+    m_timer->start(static_cast<int>(delay));
+}
+
+void UpdateChecker::onTimeout()
+{
+    // Long waits are split into steps of at most kMaxTimerMs.
+    if (QDateTime::currentMSecsSinceEpoch() + 1000 < dueMs()) {
+        schedule();
+        return;
+    }
+    checkNow();
+}
+
+void UpdateChecker::checkNow()
+{
+    if (m_network) return; // already in flight
+    if (!m_stateLoaded) loadState();
+
+    QNetworkRequest request(releaseUrl());
+    request.setHeader(QNetworkRequest::UserAgentHeader, "HourlyChime-App");
+    request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork);
+    if (!m_state.etag.isEmpty()) request.setRawHeader("If-None-Match", m_state.etag);
+    if (!m_state.lastModified.isEmpty()) request.setRawHeader("If-Modified-Since", m_state.lastModified);
+
+    m_network = new QNetworkAccessManager(this);
+    connect(m_network, &QNetworkAccessManager::finished, this, &UpdateChecker::onReplyFinished);
+    m_network->get(request);
+}
+
+void UpdateChecker::onReplyFinished(QNetworkReply *reply)
+{
+    reply->deleteLater();
+    // Nothing else needs the network stack until the next check.
+    m_network->deleteLater();
+    m_network = nullptr;
+
+    const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (status == 304) {
+        succeeded(status);
+        return;
+    }
+    if (reply->error() != QNetworkReply::NoError || status != 200) {
+        failed(status, reply->errorString());
+        return;
+    }
+
+    m_pendingStatus = status;
+    m_pendingEtag = reply->rawHeader("ETag");
+    m_pendingLastModified = reply->rawHeader("Last-Modified");
+    m_parser->setFuture(QtConcurrent::run(&UpdateChecker::parseRelease, reply->readAll()));
+}
+
+UpdateChecker::Release UpdateChecker::parseRelease(const QByteArray &json)
+{
+    QJsonObject obj = QJsonDocument::fromJson(json).object();
+    return Release{stripV(obj["tag_name"].toString()), obj["html_url"].toString()};
+}
+
+void UpdateChecker::onParsed()
+{
+    Release release = m_parser->result();
+    if (release.version.isEmpty()) {
+        failed(m_pendingStatus, "response has no tag_name");
+        return;
+    }
+
+    m_state.latestVersion = release.version;
+    m_state.latestUrl = release.url;
+    m_state.etag = m_pendingEtag;
+    m_state.lastModified = m_pendingLastModified;
+    succeeded(m_pendingStatus);
+    if (hasUpdate()) {
+        emit updateAvailable(m_state.latestVersion, m_state.latestUrl);
+    }
+}
+
+void UpdateChecker::succeeded(int httpStatus)
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    const qint64 intervalMs = qMax(1, m_intervalHours) * 3600LL * 1000;
+
+    m_state.failures = 0;
+    m_state.lastSuccessMs = now;
+    // Up to 10% jitter so installs started together drift apart.
+    m_state.jitterMs = QRandomGenerator::global()->bounded(intervalMs / 10 + 1);
+    m_state.nextCheckMs = now + intervalMs + m_state.jitterMs;
+    saveState();
+    schedule();
+    emit checkFinished(httpStatus, true);
+}
+
+void UpdateChecker::failed(int httpStatus, const QString &error)
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    const qint64 intervalMs = qMax(1, m_intervalHours) * 3600LL * 1000;
+    const int shift = qMin(m_state.failures, 16);
+    m_state.failures++;
+    m_state.nextCheckMs = now + qMin(intervalMs, kMinBackoffMs << shift);
+
+    qWarning() << "Update check failed:" << httpStatus << error
+               << "- retrying in" << (m_state.nextCheckMs - now) / 60000 << "min";
+    saveState();
+    schedule();
+    emit checkFinished(httpStatus, false);
+}
+
+void UpdateChecker::loadState()
+{
+    m_stateLoaded = true;
+    QFile file(statePath());
+    if (!file.open(QIODevice::ReadOnly)) return;
+
+    QJsonObject obj = QJsonDocument::fromJson(file.readAll()).object();
+    m_state.etag = obj["etag"].toString().toUtf8();
+    m_state.lastModified = obj["last_modified"].toString().toUtf8();
+    m_state.lastSuccessMs = obj["last_success_ms"].toInteger();
+    m_state.jitterMs = obj["jitter_ms"].toInteger();
+    m_state.nextCheckMs = obj["next_check_ms"].toInteger();
+    m_state.failures = obj["failures"].toInt();
+    m_state.latestVersion = obj["latest_version"].toString();
+    m_state.latestUrl = obj["latest_url"].toString();
+}
+
+void UpdateChecker::saveState() const
+{
+    if (!Config::makeCacheDir()) return;
+
+    QJsonObject obj;
+    obj["etag"] = QString::fromUtf8(m_state.etag);
+    obj["last_modified"] = QString::fromUtf8(m_state.lastModified);
+    obj["last_success_ms"] = m_state.lastSuccessMs;
+    obj["jitter_ms"] = m_state.jitterMs;
+    obj["next_check_ms"] = m_state.nextCheckMs;
+    obj["failures"] = m_state.failures;
+    obj["latest_version"] = m_state.latestVersion;
+    obj["latest_url"] = m_state.latestUrl;
+
+    QFile file(statePath());
+    if (file.open(QIODevice::WriteOnly)) {
+        file.write(QJsonDocument(obj).toJson(QJsonDocument::Compact));
+    }
+}
+
+bool UpdateChecker::requested(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        if (qstrcmp(argv[i], "--check-updates") == 0) return true;
+    }
+    return false;
+}
+
+int UpdateChecker::run()
+{
+    UpdateChecker checker;
+    checker.loadState();
+    checker.m_intervalHours = Config::load().updateCheckHours;
+
+    int result = 1;
+    QEventLoop loop;
+    connect(&checker, &UpdateChecker::checkFinished, &loop, [&](int httpStatus, bool ok) {
+        QTextStream out(stdout);
+        out << "url: " << releaseUrl().toString() << Qt::endl;
+        out << "status: " << httpStatus << (httpStatus == 304 ? " (not modified)" : "") << Qt::endl;
+        out << "latest: " << (checker.latestVersion().isEmpty() ? QString("unknown") : checker.latestVersion())
+            << (checker.hasUpdate() ? " (update available)" : "") << Qt::endl;
+        out << "next check: "
+            << QDateTime::fromMSecsSinceEpoch(checker.m_state.nextCheckMs).toString(Qt::ISODate) << Qt::endl;
+        result = ok ? 0 : 1;
+        loop.quit();
+    });
+    checker.checkNow();
+    loop.exec();
+    return result;
+}
@@ -0,0 +1,96 @@
+#ifndef UPDATECHECKER_H
+#define UPDATECHECKER_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QFutureWatcher>
+#include <QString>
+#include <QUrl>
+
+class QNetworkAccessManager;
+class QNetworkReply;
+class QTimer;
+
+// Checks the GitHub releases API for a newer version at most once per
+// configured interval. ETag/Last-Modified and the last answer are kept on
+// disk, so most checks are a 304 with nothing to parse, and a restart
+// doesn't trigger a new request. Failures back off exponentially. The
+// network stack is only created when a check is actually due.
+class UpdateChecker : public QObject
+{
+    Q_OBJECT
+
+public:
+    static constexpr int kStartupDelayMs = 60 * 1000;
+    static constexpr qint64 kMinBackoffMs = 15 * 60 * 1000;
+
+    explicit UpdateChecker(QObject *parent = nullptr);
+
+    // Hours between successful checks; 0 disables checking. Reschedules.
+    void setIntervalHours(int hours);
+    // Sends a request now, regardless of the schedule.
+    void checkNow();
+
+    bool hasUpdate() const;
+    QString latestVersion() const { return m_state.latestVersion; }
+    QString latestUrl() const { return m_state.latestUrl; }
+
+    // The releases endpoint; HOURLY_CHIME_UPDATE_URL overrides it so a local
+    // HTTP stand-in can be used.
+    static QUrl releaseUrl();
+    static QString statePath();
+
+    // Headless `--check-updates` mode: checks once, prints the outcome and exits.
+    static bool requested(int argc, char *argv[]);
+    static int run();
+
+signals:
+    void updateAvailable(const QString &version, const QString &url);
+    // httpStatus is 0 when no HTTP response arrived.
+    void checkFinished(int httpStatus, bool ok);
+
+private slots:
+    void onTimeout();
+    void onReplyFinished(QNetworkReply *reply);
+    void onParsed();
+
+private:
+    struct Release {
+        QString version;
+        QString url;
+    };
+
+    struct State {
+        QByteArray etag;
+        QByteArray lastModified;
+        qint64 lastSuccessMs = 0;
+        qint64 jitterMs = 0;
+        qint64 nextCheckMs = 0; // retry time while failures > 0
+        int failures = 0;
+        QString latestVersion;
+        QString latestUrl;
+    };
+
+    static Release parseRelease(const QByteArray &json);
+
+    void loadState();
+    void saveState() const;
+    qint64 dueMs() const;
+    void schedule();
+    void succeeded(int httpStatus);
+    void failed(int httpStatus, const QString &error);
+
+    State m_state;
+    bool m_stateLoaded;
+    int m_intervalHours;
+    int m_pendingStatus;
+    // Validators of the response being parsed; only kept once it parses, so a
+    // bad body is fetched in full again rather than answered with 304.
+    QByteArray m_pendingEtag;
+    QByteArray m_pendingLastModified;
+    QTimer *m_timer;
+    QNetworkAccessManager *m_network;
+    QFutureWatcher<Release> *m_parser;
+};
+
+#endif // UPDATECHECKER_H
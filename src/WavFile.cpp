@@ -0,0 +1,29 @@
+#include "WavFile.h"
+#include <QDataStream>
+
+namespace WavFile {
+
+QByteArray header(const QAudioFormat &format, quint32 dataBytes)
+{
+    QByteArray bytes;
+    QDataStream out(&bytes, QIODevice::WriteOnly);
+    out.setByteOrder(QDataStream::LittleEndian);
+
+    const quint16 formatTag = format.sampleFormat() == QAudioFormat::Float ? 3 : 1;
+
+    out.writeRawData("RIFF", 4);
+    out << quint32(kHeaderSize - 8 + dataBytes);
+    out.writeRawData("WAVEfmt ", 8);
+    out << quint32(16)
+        << formatTag
+        << quint16(format.channelCount())
+        << quint32(format.sampleRate())
+        << quint32(format.sampleRate() * format.bytesPerFrame())
+        << quint16(format.bytesPerFrame())
+        << quint16(format.bytesPerSample() * 8);
+    out.writeRawData("data", 4);
+    out << dataBytes;
+    return bytes;
+}
+
+}
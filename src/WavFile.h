@@ -0,0 +1,14 @@
+#ifndef WAVFILE_H
+#define WAVFILE_H
+
+#include <QByteArray>
+#include <QAudioFormat>
+
+namespace WavFile {
+    constexpr int kHeaderSize = 44;
+
+    // Canonical 44-byte RIFF/WAVE header for `dataBytes` of PCM in `format`.
+    QByteArray header(const QAudioFormat &format, quint32 dataBytes);
+}
+
+#endif // WAVFILE_H
@@ -2,12 +2,73 @@
 #include <QApplication>
 #include <QMessageBox>
 #include <QIcon>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QTimer>
 #include "Config.h"
+#include "OfflineRenderer.h"
+#include "LatencyProbe.h"
+#include "UpdateChecker.h"
+#include "Trace.h"
+
+#ifdef Q_OS_WIN
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+static qint64 peakRssKiB()
+{
+#ifdef Q_OS_WIN
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return -1;
+    return static_cast<qint64>(counters.PeakWorkingSetSize / 1024);
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return -1;
+#ifdef Q_OS_MACOS
+    return usage.ru_maxrss / 1024; // bytes on macOS
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
+
+static void printStartupReport(const char *stage, const QElapsedTimer &timer)
+{
+    QTextStream(stderr) << "startup-report: " << stage
+                        << " elapsed_ms=" << timer.elapsed()
+                        << " peak_rss_kib=" << peakRssKiB() << Qt::endl;
+}
 
 int main(int argc, char *argv[])
 {
+    QElapsedTimer startupTimer;
+    startupTimer.start();
+    Trace::consumeArguments(argc, argv);
+
+    // Headless modes must not touch the GUI, so check before QApplication.
+    if (OfflineRenderer::requested(argc, argv)) {
+        QCoreApplication app(argc, argv);
+        return OfflineRenderer::run(app.arguments());
+    }
+    if (LatencyProbe::requested(argc, argv)) {
+        QCoreApplication app(argc, argv);
+        return LatencyProbe::run();
+    }
+    if (UpdateChecker::requested(argc, argv)) {
+        QCoreApplication app(argc, argv);
+        return UpdateChecker::run();
+    }
+
+    const qint64 appStartNs = Trace::nowNs();
     QApplication app(argc, argv);
     QApplication::setQuitOnLastWindowClosed(false);
+    Trace::complete("QApplication", appStartNs, Trace::nowNs());
 
     qRegisterMetaType<Config::AppConfig>();
 
@@ -33,5 +94,12 @@ int main(int argc, char *argv[])
         chimeApp.showSettings();
     }
 
+    // Prints time-to-event-loop and peak RSS, then again once deferred
+    // initialization has settled.
+    if (args.contains("--startup-report")) {
+        QTimer::singleShot(0, &app, [&startupTimer]() { printStartupReport("event-loop", startupTimer); });
+        QTimer::singleShot(10000, &app, [&startupTimer]() { printStartupReport("idle-10s", startupTimer); });
+    }
+
     return app.exec();
 }
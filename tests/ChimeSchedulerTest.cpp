@@ -0,0 +1,55 @@
+// ChimeSchedulerTest: checks the hour boundaries ChimeScheduler arms for
+// around DST changes, where rebuilding an hour from its local date and time
+// is ambiguous.
+#include "ChimeScheduler.h"
+#include <QTimeZone>
+#include <QtTest>
+
+class ChimeSchedulerTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void boundaryAfter_data();
+    void boundaryAfter();
+};
+
+void ChimeSchedulerTest::boundaryAfter_data()
+{
+    QTest::addColumn<QString>("timezone");
+    QTest::addColumn<QString>("fromUtc");
+    QTest::addColumn<QString>("expectedUtc");
+
+    QTest::newRow("plain hour") << "Europe/Berlin" << "2026-06-01T10:15:00Z" << "2026-06-01T11:00:00Z";
+    // 02:30 CEST, then 02:00 CET: the repeated hour must be reached.
+    QTest::newRow("fall-back into repeat") << "Europe/Berlin" << "2026-10-25T00:30:00Z" << "2026-10-25T01:00:00Z";
+    // From the repeated 02:00 CET the next boundary is 03:00 CET, not the
+    // same instant again.
+    QTest::newRow("fall-back out of repeat") << "Europe/Berlin" << "2026-10-25T01:00:00Z" << "2026-10-25T02:00:00Z";
+    // 01:30 CET, then 03:00 CEST: 02:00 never happens.
+    QTest::newRow("spring-forward") << "Europe/Berlin" << "2026-03-29T00:30:00Z" << "2026-03-29T01:00:00Z";
+    // 01:45 +11:00 falls back to 01:30 +10:30; the hour starts at 02:00.
+    QTest::newRow("half-hour fall-back") << "Australia/Lord_Howe" << "2026-04-04T14:45:00Z" << "2026-04-04T15:30:00Z";
+}
+
+void ChimeSchedulerTest::boundaryAfter()
+{
+    QFETCH(QString, timezone);
+    QFETCH(QString, fromUtc);
+    QFETCH(QString, expectedUtc);
+
+    const QTimeZone zone(timezone.toLatin1());
+    QVERIFY(zone.isValid());
+    const QDateTime from = QDateTime::fromString(fromUtc, Qt::ISODate).toTimeZone(zone);
+    const QDateTime expected = QDateTime::fromString(expectedUtc, Qt::ISODate);
+    QVERIFY(from.isValid());
+    QVERIFY(expected.isValid());
+
+    const QDateTime next = ChimeScheduler::boundaryAfter(from);
+    QCOMPARE(next.toMSecsSinceEpoch(), expected.toMSecsSinceEpoch());
+    QCOMPARE(next.timeZone(), zone);
+    QCOMPARE(next.time().minute(), 0);
+}
+
+QTEST_GUILESS_MAIN(ChimeSchedulerTest)
+#include "ChimeSchedulerTest.moc"
@@ -0,0 +1,83 @@
+// SampleCacheTest: checks which files SampleCache keeps in memory and which
+// it streams, including after settings that rebuild the cache.
+#include "SampleCache.h"
+#include "WavFile.h"
+#include <QFile>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QtMath>
+#include <QtTest>
+
+namespace {
+
+constexpr int kDecodeTimeoutMs = 10000;
+
+// Int16 mono WAV holding `ms` of a 440 Hz sine.
+bool writeSine(const QString &path, const QAudioFormat &format, int ms)
+{
+    QVector<qint16> pcm(format.framesForDuration(qint64(ms) * 1000));
+    for (int f = 0; f < pcm.size(); ++f) {
+        pcm[f] = static_cast<qint16>(qRound(16000.0 * qSin(2.0 * M_PI * 440.0 * f / format.sampleRate())));
+    }
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) return false;
+    const qint64 bytes = pcm.size() * qint64(sizeof(qint16));
+    file.write(WavFile::header(format, static_cast<quint32>(bytes)));
+    file.write(reinterpret_cast<const char *>(pcm.constData()), bytes);
+    return true;
+}
+
+}
+
+class SampleCacheTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void repeatedStaysInMemory();
+
+private:
+    QTemporaryDir m_samples;
+};
+
+void SampleCacheTest::initTestCase()
+{
+    // The analysis cache must not touch the user's config directory.
+    QStandardPaths::setTestModeEnabled(true);
+    QVERIFY(m_samples.isValid());
+}
+
+void SampleCacheTest::repeatedStaysInMemory()
+{
+    QAudioFormat format;
+    format.setSampleRate(8000);
+    format.setChannelCount(1);
+    format.setSampleFormat(QAudioFormat::Int16);
+
+    // Both are over the streaming threshold set below.
+    const QString prelude = m_samples.filePath("prelude.wav");
+    const QString strike = m_samples.filePath("strike.wav");
+    QVERIFY(writeSine(prelude, format, 500));
+    QVERIFY(writeSine(strike, format, 500));
+    const QStringList paths = {prelude, strike};
+
+    SampleCache cache(format);
+    cache.setStreaming(1024, 250);
+    cache.setPaths(paths, {strike});
+    QTRY_VERIFY_WITH_TIMEOUT(!cache.isPending(paths), kDecodeTimeoutMs);
+    QVERIFY(cache.isStreamed(prelude));
+    QVERIFY(!cache.isStreamed(strike));
+    QVERIFY(!cache.pcm(strike).isEmpty());
+
+    // Normalization is on by default; turning it off rebuilds every entry.
+    cache.setNormalize(false);
+    QTRY_VERIFY_WITH_TIMEOUT(!cache.isPending(paths), kDecodeTimeoutMs);
+    QVERIFY(cache.isStreamed(prelude));
+    QVERIFY(!cache.isStreamed(strike));
+    QVERIFY(!cache.pcm(strike).isEmpty());
+}
+
+QTEST_GUILESS_MAIN(SampleCacheTest)
+#include "SampleCacheTest.moc"
@@ -0,0 +1,318 @@
+// SimulationTest: runs HourlyChime itself on a VirtualClock through weeks of
+// local time (DST changes, midnights, suspend/resume gaps), with a
+// CaptureSink in place of the audio device. The chimes that fire, the strikes
+// heard in the captured audio and the frames they start at are checked
+// against what the calendar says should happen. Config and caches live in
+// QStandardPaths' test location, never the user's.
+#include "CaptureSink.h"
+#include "ChimeScheduler.h"
+#include "Clock.h"
+#include "Config.h"
+#include "HourlyChime.h"
+#include "Oscillator.h"
+#include "SampleAnalyzer.h"
+#include "WavFile.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSignalSpy>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QtMath>
+#include <QtTest>
+#include <limits>
+
+namespace {
+
+// Synthetic sounds with sharp attacks and silent tails, so a plain level gate
+// finds every strike in the capture at the exact frame it starts.
+constexpr int kPreludeToneMs = 200;
+constexpr int kPreludeMs = 250;
+constexpr int kStrikeToneMs = 150;
+constexpr int kStrikeDecayMs = 30;
+constexpr int kStrikeMs = 200;
+constexpr float kAmplitude = 0.5f;
+// Level, relative to a sound's peak, the gate treats as silence.
+constexpr float kGateRatio = 0.1f;
+constexpr int kGapFrames = 16;
+constexpr qint64 kHourMs = 3600 * 1000;
+constexpr int kChimeTimeoutMs = 10000;
+constexpr int kMaxReported = 20;
+
+struct Suspend {
+    qint64 startMs;
+    qint64 endMs;
+};
+
+// Int16 PCM holding `toneMs` of a cosine (so the very first frame is loud),
+// decaying with time constant `decayMs` if non-zero, then silence up to
+// `totalMs`.
+QByteArray tone(const QAudioFormat &format, double hz, int toneMs, int decayMs, int totalMs)
+{
+    const int channels = format.channelCount();
+    const qint64 frames = format.framesForDuration(qint64(totalMs) * 1000);
+    const qint64 toneFrames = format.framesForDuration(qint64(toneMs) * 1000);
+    QVector<qint16> pcm(frames * channels, 0);
+    for (qint64 f = 0; f < toneFrames; ++f) {
+        const double t = static_cast<double>(f) / format.sampleRate();
+        const double envelope = decayMs > 0 ? qExp(-t * 1000.0 / decayMs) : 1.0;
+        const qint16 v = static_cast<qint16>(qRound(32767.0 * kAmplitude * envelope * qCos(2.0 * M_PI * hz * t)));
+        for (int c = 0; c < channels; ++c) pcm[f * channels + c] = v;
+    }
+    return QByteArray(reinterpret_cast<const char *>(pcm.constData()), pcm.size() * qint64(sizeof(qint16)));
+}
+
+bool writeWav(const QString &path, const QAudioFormat &format, const QByteArray &pcm)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) return false;
+    file.write(WavFile::header(format, static_cast<quint32>(pcm.size())));
+    file.write(pcm);
+    return true;
+}
+
+// What "auto" spacing the app will find in `pcm`, from the same analyzer
+// the decoder runs.
+qint64 proposedIntervalUs(const QAudioFormat &format, const QByteArray &pcm)
+{
+    const int samples = static_cast<int>(pcm.size() / format.bytesPerSample());
+    QVector<float> floats(samples, 0.0f);
+    SampleWriter::accumulator(format.sampleFormat())(pcm.constData(), floats.data(), samples, 1.0f);
+    SampleAnalyzer analyzer(format.sampleRate(), format.channelCount());
+    analyzer.feed(floats.constData(), samples / format.channelCount());
+    return analyzer.result().strikeIntervalUs;
+}
+
+// Every instant in (fromMs, toMs) at which local time in `zone` is on the
+// hour, found by walking UTC in quarter hours rather than the way
+// ChimeScheduler finds them.
+QVector<qint64> hourBoundaries(qint64 fromMs, qint64 toMs, const QTimeZone &zone)
+{
+    constexpr qint64 kStepMs = 15 * 60 * 1000;
+    QVector<qint64> result;
+    for (qint64 ms = (fromMs / kStepMs + 1) * kStepMs; ms < toMs; ms += kStepMs) {
+        const QTime t = QDateTime::fromMSecsSinceEpoch(ms, zone).time();
+        if (t.minute() == 0 && t.second() == 0) result.append(ms);
+    }
+    return result;
+}
+
+QString framesList(const QVector<qint64> &frames)
+{
+    QStringList list;
+    for (qint64 f : frames) list << QString::number(f);
+    return list.join(',');
+}
+
+}
+
+class SimulationTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void chimes_data();
+    void chimes();
+
+private:
+    static QString configDir() { return QFileInfo(Config::getConfigPath()).absolutePath(); }
+
+    QTemporaryDir m_samples;
+};
+
+void SimulationTest::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+    QDir(configDir()).removeRecursively();
+    QVERIFY(m_samples.isValid());
+}
+
+void SimulationTest::cleanupTestCase()
+{
+    QDir(configDir()).removeRecursively();
+}
+
+void SimulationTest::chimes_data()
+{
+    QTest::addColumn<QString>("timezone");
+    QTest::addColumn<QString>("start");
+    QTest::addColumn<int>("days");
+    QTest::addColumn<int>("intervalMs");
+    QTest::addColumn<int>("suspendEveryHours"); // 0 for none
+    QTest::addColumn<int>("suspendSeconds");
+    QTest::addColumn<int>("rate");
+
+    QTest::newRow("year") << "Europe/Berlin" << "2026-01-01T00:00:00" << 365 << 300 << 53 << 6163 << 8000;
+    QTest::newRow("back-to-back") << "America/New_York" << "2026-02-20T12:30:00" << 120 << -1 << 0 << 0 << 8000;
+    // Lord Howe Island moves its clocks by half an hour.
+    QTest::newRow("auto") << "Australia/Lord_Howe" << "2026-03-20T00:00:00" << 60 << Config::kStrikeIntervalAuto
+                          << 29 << 600 << 11025;
+}
+
+void SimulationTest::chimes()
+{
+    QFETCH(QString, timezone);
+    QFETCH(QString, start);
+    QFETCH(int, days);
+    QFETCH(int, intervalMs);
+    QFETCH(int, suspendEveryHours);
+    QFETCH(int, suspendSeconds);
+    QFETCH(int, rate);
+
+    const QTimeZone zone(timezone.toLatin1());
+    const QDateTime startLocal = QDateTime::fromString(start, Qt::ISODate);
+    QVERIFY(zone.isValid());
+    QVERIFY(startLocal.isValid());
+    if (suspendEveryHours > 0) {
+        QVERIFY2(qint64(suspendSeconds) * 1000 < suspendEveryHours * kHourMs, "suspends must not overlap");
+    }
+
+    QAudioFormat format;
+    format.setSampleRate(rate);
+    format.setChannelCount(1);
+    format.setSampleFormat(QAudioFormat::Int16);
+
+    const QString tag = QString::fromLatin1(QTest::currentDataTag());
+    const QByteArray strikePcm = tone(format, 660.0, kStrikeToneMs, kStrikeDecayMs, kStrikeMs);
+    Config::AppConfig cfg = Config::getDefaults();
+    cfg.mode = "GrandfatherClock";
+    cfg.preludeFilePath = m_samples.filePath(tag + "-prelude.wav");
+    cfg.strikeFilePath = m_samples.filePath(tag + "-strike.wav");
+    cfg.strikeIntervalMs = intervalMs;
+    // Trimming would move the starts this checks by the trimmed amount.
+    cfg.normalizeSamples = false;
+    cfg.updateCheckHours = 0;
+    QVERIFY(writeWav(cfg.preludeFilePath, format, tone(format, 330.0, kPreludeToneMs, 0, kPreludeMs)));
+    QVERIFY(writeWav(cfg.strikeFilePath, format, strikePcm));
+    Config::save(cfg);
+
+    // What the strikes should sound like, from the data rather than from
+    // StrikePlan.
+    const qint64 preludeFrames = format.framesForDuration(qint64(kPreludeMs) * 1000);
+    qint64 intervalFrames = format.framesForDuration(qint64(kStrikeMs) * 1000);
+    if (intervalMs >= 0) {
+        intervalFrames = format.framesForDuration(qint64(intervalMs) * 1000);
+    } else if (intervalMs == Config::kStrikeIntervalAuto) {
+        const qint64 proposedUs = proposedIntervalUs(format, strikePcm);
+        if (proposedUs > 0) intervalFrames = format.framesForDuration(proposedUs);
+    }
+    // Overlapping strikes can't be told apart by the level gate.
+    QVERIFY(intervalFrames >= format.framesForDuration(qint64(kStrikeMs) * 1000));
+    const float gate = kGateRatio * kAmplitude * cfg.volume;
+
+    const qint64 startMs = QDateTime(startLocal.date(), startLocal.time(), zone).toMSecsSinceEpoch();
+    const qint64 endMs = startMs + days * 24 * kHourMs;
+    VirtualClock clock(startMs, zone);
+    CaptureSink capture(format);
+    HourlyChime chime(&clock, &capture);
+    ChimeScheduler *scheduler = chime.chimeScheduler();
+    // Loads the config saved above, which settles the format and starts decoding.
+    QCoreApplication::processEvents();
+
+    QVector<qint64> chimed;
+    QStringList failures;
+    qint64 strikesHeard = 0;
+    QSignalSpy finished(&chime, &HourlyChime::testFinished);
+    connect(scheduler, &ChimeScheduler::hourReached, this, [&](const QDateTime &boundary) {
+        chimed.append(boundary.toMSecsSinceEpoch());
+    });
+
+    // Lets the scheduler run at the clock's time; a chime is played through
+    // to the end and its capture checked.
+    auto wake = [&]() {
+        const int before = chimed.size();
+        scheduler->wake();
+        if (chimed.size() == before) return;
+
+        const qint64 boundaryMs = chimed.last();
+        const QString at = QDateTime::fromMSecsSinceEpoch(boundaryMs, zone).toString(Qt::ISODate);
+        if (finished.isEmpty() && !finished.wait(kChimeTimeoutMs)) {
+            failures << QString("%1: the chime never finished").arg(at);
+            return;
+        }
+        finished.clear();
+
+        const int hour = QDateTime::fromMSecsSinceEpoch(boundaryMs, zone).time().hour();
+        const int strikes = hour % 12 == 0 ? 12 : hour % 12;
+        QVector<qint64> expected = {0};
+        for (int k = 0; k < strikes; ++k) expected << preludeFrames + k * intervalFrames;
+
+        const QVector<qint64> heard = capture.onsets(gate, kGapFrames);
+        capture.clear();
+        strikesHeard += qMax(0, static_cast<int>(heard.size()) - 1);
+        if (heard != expected) {
+            failures << QString("%1: expected the prelude and %2 strikes at frames %3, heard %4 sounds at %5")
+                            .arg(at).arg(strikes).arg(framesList(expected)).arg(heard.size()).arg(framesList(heard));
+        }
+    };
+
+    // Time only moves here: straight to each wakeup the scheduler asks for,
+    // or over a suspend, after which an overdue wakeup fires at once as a
+    // timerfd would on resume.
+    const qint64 suspendEveryMs = suspendEveryHours * kHourMs;
+    const qint64 suspendMs = qint64(suspendSeconds) * 1000;
+    qint64 nextSuspend = suspendEveryMs > 0 ? startMs + suspendEveryMs + 17 * 60 * 1000
+                                            : std::numeric_limits<qint64>::max();
+    QVector<Suspend> suspends;
+    while (scheduler->wakeTimeMs() < endMs) {
+        const qint64 wakeMs = scheduler->wakeTimeMs();
+        if (nextSuspend <= wakeMs) {
+            suspends.append(Suspend{nextSuspend, nextSuspend + suspendMs});
+            clock.setMSecsSinceEpoch(nextSuspend + suspendMs);
+            nextSuspend += suspendEveryMs;
+            if (scheduler->wakeTimeMs() <= clock.nowMs()) wake();
+            continue;
+        }
+        clock.setMSecsSinceEpoch(wakeMs);
+        wake();
+    }
+
+    // The chimes the calendar calls for: every local hour, except those
+    // slept through by more than the scheduler's grace period.
+    QVector<qint64> expectedChimes;
+    int skipped = 0;
+    int midnights = 0;
+    int offsetChanges = 0;
+    int previousOffset = QDateTime::fromMSecsSinceEpoch(startMs, zone).offsetFromUtc();
+    for (qint64 b : hourBoundaries(startMs, endMs, zone)) {
+        const QDateTime local = QDateTime::fromMSecsSinceEpoch(b, zone);
+        if (local.offsetFromUtc() != previousOffset) ++offsetChanges;
+        previousOffset = local.offsetFromUtc();
+
+        bool asleep = false;
+        for (const Suspend &s : suspends) {
+            if (b >= s.startMs && s.endMs - b > ChimeScheduler::kLateGraceMs) asleep = true;
+        }
+        if (asleep) {
+            ++skipped;
+            continue;
+        }
+        expectedChimes << b;
+        if (local.time().hour() == 0) ++midnights;
+    }
+
+    if (chimed != expectedChimes) {
+        int i = 0;
+        while (i < chimed.size() && i < expectedChimes.size() && chimed[i] == expectedChimes[i]) ++i;
+        auto at = [&zone](const QVector<qint64> &list, int index) {
+            return index < list.size() ? QDateTime::fromMSecsSinceEpoch(list[index], zone).toString(Qt::ISODate)
+                                       : QString("nothing");
+        };
+        failures.prepend(QString("Chime %1 of %2: expected %3, the scheduler chimed %4 (%5 chimes in all)")
+                             .arg(i + 1).arg(expectedChimes.size())
+                             .arg(at(expectedChimes, i), at(chimed, i)).arg(chimed.size()));
+    }
+
+    qInfo().noquote() << QString("Simulated %1 days in %2: %3 chimes, %4 strikes, %5 midnights, "
+                                 "%6 UTC offset changes, %7 hours slept through in %8 suspends")
+                             .arg(days).arg(timezone).arg(chimed.size()).arg(strikesHeard).arg(midnights)
+                             .arg(offsetChanges).arg(skipped).arg(suspends.size());
+
+    QVERIFY2(failures.isEmpty(), qPrintable(QString("%1 mismatches:\n%2").arg(failures.size())
+                                                .arg(failures.mid(0, kMaxReported).join('\n'))));
+}
+
+QTEST_MAIN(SimulationTest)
+#include "SimulationTest.moc"